@@ -0,0 +1,67 @@
+
+// Load the project config first, the ADC functions depend on the sampler settings
+#include "config.h"
+#include "adc.h"
+
+// Only implement the interrupt when the free-running ADC is enabled
+#if RX_ANALOG && (RX_ANALOG_FREERUN || RX_OVERSAMPLE) && defined(ARDUINO)
+
+#if RX_OVERSAMPLE
+
+oversampler_t adc_filter;
+
+/**
+ * Conversion complete: push the top 8 bits into the filter, the next conversion is already running
+ */
+ISR(ADC_vect) {
+  RX_OVERSAMPLE_PUSH(&adc_filter, ADCH);
+}
+
+#else
+
+volatile uint8_t adc_level = 0;
+volatile uint16_t adc_value = 0;
+
+static slicer_t slicer;
+
+/**
+ * Conversion complete: slice the reading and publish it, the next conversion is already running
+ */
+ISR(ADC_vect) {
+  uint16_t val = ADC;
+  adc_value = val;
+  adc_level = RX_SLICE(&slicer, val);
+}
+
+#endif
+
+/**
+ * Start converting the analog pin continuously
+ */
+void adc_start_freerun(uint8_t pin) {
+  uint8_t channel = (pin - A0) & 0x07;
+
+#if RX_OVERSAMPLE
+  oversample_init(&adc_filter, RX_ANALOG_LEVEL_HIGH, RX_ANALOG_LEVEL_LOW);
+#else
+  slicer_init(&slicer, RX_ANALOG_LEVEL_HIGH, RX_ANALOG_LEVEL_LOW);
+#endif
+
+  noInterrupts();
+#if RX_OVERSAMPLE
+  ADMUX = _BV(REFS0) | _BV(ADLAR) | channel;   // Left adjusted result, the top 8 bits in ADCH
+#else
+  ADMUX = _BV(REFS0) | channel;        // AVcc reference as analogRead() uses, right adjusted result
+#endif
+  ADCSRB = 0;                          // Auto trigger source: free running
+  DIDR0 |= _BV(channel);               // The digital input buffer on the pin only adds noise
+#if RX_OVERSAMPLE
+  ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | ADC_OVERSAMPLE_PRESCALER;
+#else
+  ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | ADC_FREERUN_PRESCALER;
+#endif
+  ADCSRA |= _BV(ADSC);                 // First conversion, the others follow automatically
+  interrupts();
+}
+
+#endif
@@ -26,4 +26,69 @@ inline static void set_ADC_speed() {
   ADCSRA |= PS_16;    // set our own prescaler to 64 
 }
 
+/**
+ * Free-running mode (RX_ANALOG_FREERUN): the ADC restarts itself after every conversion and the conversion complete
+ * interrupt slices the reading (see slicer.h), so reading a sample never waits on a conversion.
+ * A conversion takes 13 ADC clocks; PS_32 gives 26us per conversion, about two per sample at the default interval,
+ * while leaving most of the CPU to the decoder.
+ */
+#define ADC_FREERUN_PRESCALER PS_32
+
+/**
+ * Oversampling (RX_OVERSAMPLE): PS_16 gives a conversion every 13us, 4 per sample at the default interval
+ * (OVERSAMPLE_CONVERSION_US). The result is left adjusted so the interrupt reads the top 8 bits from ADCH alone and
+ * pushes them into the filter of oversample.h; the slicer runs once per sample in adc_oversample().
+ */
+#define ADC_OVERSAMPLE_PRESCALER PS_16
+
+// Level and reading of the latest conversion, written by the interrupt
+extern volatile uint8_t adc_level;
+extern volatile uint16_t adc_value;
+
+#if RX_OVERSAMPLE
+// Oversampling filter, the interrupt pushes the readings
+extern oversampler_t adc_filter;
+#endif
+
+/**
+ * Start converting the analog pin continuously
+ */
+void adc_start_freerun(uint8_t pin);
+
+/**
+ * Latest sliced sample
+ */
+static inline uint8_t adc_sample() {
+  return adc_level;
+}
+
+/**
+ * Latest raw reading
+ */
+static inline uint16_t adc_reading() {
+  uint16_t res;
+  noInterrupts();
+#if RX_OVERSAMPLE
+  res = (uint16_t)adc_filter.readings[(adc_filter.pos - 1) & OVERSAMPLE_MASK] << 2;
+#else
+  res = adc_value;
+#endif
+  interrupts();
+  return res;
+}
+
+#if RX_OVERSAMPLE
+/**
+ * Sample from the readings since the last one. Only the state the interrupt writes is read with it held off; the
+ * timer sampler calls this from its own interrupt, so the interrupt flag is restored rather than set.
+ */
+static inline uint8_t adc_oversample() {
+  uint8_t sreg = SREG;
+  noInterrupts();
+  uint16_t state = RX_OVERSAMPLE_STATE(&adc_filter);
+  SREG = sreg;
+  return RX_OVERSAMPLE_SAMPLE(&adc_filter, state);
+}
+#endif
+
 #endif
@@ -0,0 +1,59 @@
+/**
+ * Bit-sliced pulse counters - the run length counters of up to 8 receivers, counted in parallel
+ *
+ * Instead of one counter byte per receiver, bit k of all counters is kept together in one byte (a bit plane): bit i
+ * of plane k is bit k of the counter of receiver i. One pass of byte operations over the planes then adds 1 to all
+ * 8 counters at once (a ripple carry adder, one receiver per bit), compares them all with a constant or clears some
+ * of them. The cost per sample does not depend on the number of receivers, and the planes of 7 bit counters take
+ * 7 bytes.
+ *
+ * This is plain logic so the host tools can run it (host/multibench.cpp).
+ */
+
+#ifndef _BITSLICE_H_
+#define _BITSLICE_H_
+
+#include <stdint.h>
+
+// Bits per counter: enough for the longest pulse the pulse detector counts (see MAX_ZEROES in decoder.h)
+#define BITSLICE_BITS 7
+
+/**
+ * Add 1 to the counters of the receivers in mask
+ */
+static inline void bitslice_count(uint8_t *planes, uint8_t mask) {
+  uint8_t carry = mask;
+  for(uint8_t k = 0; k < BITSLICE_BITS && carry; k++) {
+    uint8_t next = planes[k] & carry;
+    planes[k] ^= carry;
+    carry = next;
+  }
+}
+
+/**
+ * Compare all counters with a constant
+ * @return the receivers whose counter equals value
+ */
+static inline uint8_t bitslice_equal(const uint8_t *planes, uint8_t value) {
+  uint8_t eq = 0xFF;
+  for(uint8_t k = 0; k < BITSLICE_BITS; k++) eq &= (value >> k) & 0x1 ? planes[k] : ~planes[k];
+  return eq;
+}
+
+/**
+ * Reset the counters of the receivers in mask to 0
+ */
+static inline void bitslice_clear(uint8_t *planes, uint8_t mask) {
+  for(uint8_t k = 0; k < BITSLICE_BITS; k++) planes[k] &= ~mask;
+}
+
+/**
+ * Counter of one receiver
+ */
+static inline uint8_t bitslice_get(const uint8_t *planes, uint8_t receiver) {
+  uint8_t n = 0;
+  for(uint8_t k = 0; k < BITSLICE_BITS; k++) n |= ((planes[k] >> receiver) & 0x1) << k;
+  return n;
+}
+
+#endif
@@ -0,0 +1,135 @@
+
+#include "capture.h"
+// Load the project config
+#include "config.h"
+
+// Only implement the functions when the edge capture is enabled
+#if RX_CAPTURE && defined(ARDUINO)
+
+// Timer1 runs at F_CPU / 8: 0.5 us per tick at 16 MHz
+#define CAPTURE_TICKS_PER_US (F_CPU / 8000000UL)
+
+// When no edge is seen for this long, the current pulse is reported anyway so a frame end is detected without
+// waiting for the next (noise) edge
+#define CAPTURE_TIMEOUT_TICKS ((uint16_t)(END_PULSE_US * CAPTURE_TICKS_PER_US))
+
+// Queue between the interrupt and the main loop: the interrupt only writes the head, the main loop only the tail
+static volatile uint8_t  q_level[CAPTURE_QUEUE_SIZE];
+static volatile uint16_t q_duration[CAPTURE_QUEUE_SIZE];
+static volatile uint8_t  q_head = 0;
+static volatile uint8_t  q_tail = 0;
+static volatile uint16_t q_overruns = 0;
+
+static uint16_t last_edge = 0;   // Timestamp of the previous edge
+static uint8_t timed_out = 0;    // Set when the current pulse was already reported by the timeout
+
+/**
+ * Queue a pulse, called from the interrupts only
+ */
+static inline void push(uint8_t level, uint16_t duration_us) {
+  uint8_t next = (q_head + 1) & (CAPTURE_QUEUE_SIZE - 1);
+  if(next == q_tail) {
+    // Queue full - drop the pulse, the decoder will resync on the next SYNC
+    q_overruns++;
+    return;
+  }
+  q_level[q_head] = level;
+  q_duration[q_head] = duration_us;
+  q_head = next;
+}
+
+/**
+ * Level of the pulse currently on the pin: while waiting for a rising edge, the pin is low
+ */
+static inline uint8_t currentLevel() {
+  uint8_t level = (TCCR1B & _BV(ICES1)) ? 0 : 1;
+#if RX_INVERT
+  return !level;
+#else
+  return level;
+#endif
+}
+
+/**
+ * Edge captured: the pulse before the edge is complete
+ */
+ISR(TIMER1_CAPT_vect) {
+  uint16_t now = ICR1;
+  uint8_t level = currentLevel();
+
+  // Capture the opposite edge next; the datasheet requires clearing the flag after changing the edge
+  TCCR1B ^= _BV(ICES1);
+  TIFR1 = _BV(ICF1);
+
+  // A pulse which was cut off by the timeout is not reported a second time
+  if(!timed_out) {
+    push(level, (now - last_edge) / CAPTURE_TICKS_PER_US);
+  }
+
+  timed_out = 0;
+  last_edge = now;
+  OCR1A = now + CAPTURE_TIMEOUT_TICKS;
+}
+
+/**
+ * No edge for CAPTURE_TIMEOUT_TICKS: report the pulse as long as the timeout
+ */
+ISR(TIMER1_COMPA_vect) {
+  // The compare matches again every timer wrap, only report once
+  if(!timed_out) {
+    push(currentLevel(), END_PULSE_US);
+    timed_out = 1;
+  }
+}
+
+/**
+ * Configure Timer1 for input capture on both edges and start queueing pulses
+ */
+void capture_start() {
+  pinMode(rxPinCapture, INPUT);
+
+  noInterrupts();
+  TCCR1A = 0;                         // Normal mode, free running 16 bit counter
+  TCCR1B = _BV(ICNC1) | _BV(CS11);   // Noise canceler, capture falling edge, clock / 8
+  if(!digitalRead(rxPinCapture)) {
+    TCCR1B |= _BV(ICES1);             // Pin is low: the next edge is a rising one
+  }
+  // The counter keeps running: the transmitter may be sending on compare B
+  last_edge = TCNT1;
+  OCR1A = last_edge + CAPTURE_TIMEOUT_TICKS;
+  TIFR1 = _BV(ICF1) | _BV(OCF1A);     // Clear stale flags
+  TIMSK1 = (TIMSK1 & _BV(OCIE1B)) | _BV(ICIE1) | _BV(OCIE1A);  // Capture and timeout interrupts
+  interrupts();
+}
+
+/**
+ * Check if pulses are waiting in the queue
+ */
+uint8_t capture_pending() {
+  return q_tail != q_head;
+}
+
+/**
+ * Take the oldest pulse from the queue
+ */
+uint8_t capture_read(uint8_t *level, uint16_t *duration_us) {
+  if(q_tail == q_head) return 0;
+
+  *level = q_level[q_tail];
+  *duration_us = q_duration[q_tail];
+  q_tail = (q_tail + 1) & (CAPTURE_QUEUE_SIZE - 1);
+  return 1;
+}
+
+/**
+ * Number of pulses dropped because the main loop did not empty the queue in time
+ */
+uint16_t capture_overruns() {
+  uint16_t res;
+  noInterrupts();
+  res = q_overruns;
+  interrupts();
+  return res;
+}
+
+#endif
@@ -0,0 +1,37 @@
+/**
+ * Edge capture - times the receiver edges with the Timer1 input capture unit instead of sampling the receiver
+ *
+ * Every edge on rxPinCapture (ICP1) is timestamped by the hardware, the pulse width is queued by the interrupt
+ * and decoded from the main loop with decodeEdge(). Between edges no code runs at all.
+ */
+
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <stdint.h>
+
+// Number of pulses that can be queued between the interrupt and the main loop (power of 2)
+#define CAPTURE_QUEUE_SIZE 32
+
+/**
+ * Configure Timer1 for input capture on both edges and start queueing pulses
+ */
+void capture_start();
+
+/**
+ * Take the oldest pulse from the queue
+ * @return 0 when the queue is empty, 1 when *level and *duration_us were filled in
+ */
+uint8_t capture_read(uint8_t *level, uint16_t *duration_us);
+
+/**
+ * Check if pulses are waiting in the queue
+ */
+uint8_t capture_pending();
+
+/**
+ * Number of pulses dropped because the main loop did not empty the queue in time
+ */
+uint16_t capture_overruns();
+
+#endif
@@ -29,6 +29,36 @@
  */
 #define ENABLE_RECORDER 0
 
+/**
+ * Add-on: Nexa transmitter on txPin, works with any of the modules above
+ *
+ * Sends packets from the Timer1 compare B interrupt while the module keeps running (see transmitter.h). Nothing in the
+ * modules sends, enable it when your code calls tx_send(): it takes Timer1, so pins 9 and 10 lose their PWM.
+ */
+#define ENABLE_TRANSMITTER 0
+
+/**
+ * Add-on: pass every new packet to the handlers registered for its remote (full decoder)
+ *
+ * The handlers and the table of remotes, stored in flash, are in devices.cpp (see dispatch.h).
+ */
+#define ENABLE_DISPATCH 0
+
+/**
+ * Instrumentation: time every iteration of the polled sample loop (decoder modules)
+ *
+ * Counts overruns and the time per stage on Timer1, reported on request or every TIMING_REPORT_S seconds (see timing.h).
+ * Off by default: it takes Timer1, so pins 9 and 10 lose their PWM, and a report holds up the sample loop while it
+ * is printed. Enable it to tune the sample interval or to look for overruns.
+ */
+#define SAMPLE_LOOP_TIMING 0
+
+/**
+ * Serial console speed. The streaming recorder sends every sample to the host and needs a much faster link.
+ */
+#define SERIAL_BAUD 9600
+#define SERIAL_BAUD_STREAM 250000
+
 // ------------------------- Sanity tests --------------------------
 #if (ENABLE_FULL_DECODER + ENABLE_DEBUG_DECODER + ENABLE_RECORDER) > 1
 #error "Select exactly one of the modules to compile!"
@@ -38,6 +68,10 @@
 #error "No module enabled!"
 #endif
 
+#if ENABLE_DISPATCH && !ENABLE_FULL_DECODER
+#error "The packet dispatch needs the full decoder"
+#endif
+
 // ------------------------- Selective inclusion --------------------
 
 // Sampler settings (used in all modules)
@@ -45,7 +79,9 @@
 // Sample settings and protocol settings
 #include "protocol.h"
 // ADC control functions (for faster sampling)
+#ifdef ARDUINO
 #include "adc.h"
+#endif
 
 #if ENABLE_RECORDER
 #include "recorder.h"
@@ -59,4 +95,16 @@
 #include "decoder_debug.h"
 #endif
 
+#if ENABLE_TRANSMITTER
+#include "transmitter.h"
+#endif
+
+#if ENABLE_DISPATCH
+#include "devices.h"
+#endif
+
+#if SAMPLE_LOOP_TIMING
+#include "timing.h"
+#endif
+
 #endif
@@ -1,5 +1,9 @@
 /**
- * NEXA protocol decoder - shared logic
+ * NEXA protocol decoder - shared logic: the pulse detector
+ *
+ * Turns the samples (or the pulse lengths of edge timing and run-length input) of one receiver into the events of
+ * the frame decoder. Header only, like the frame stages it feeds: it needs no module of config.h, and the host tools
+ * build the same code.
  */
 
 #ifndef _DECODER_H_
@@ -7,6 +11,9 @@
 
 #include <stdint.h>
 
+// Pulse windows and the clock recovery setting
+#include "protocol.h"
+
 // Events from the detector
 #define EVENT_NONE 0
 #define EVENT_INVALID 1
@@ -16,12 +23,396 @@
 #define EVENT_SYNC 13
 #define EVENT_PAUSE 14
 
+// The pulse counters stop counting at this value; a low pulse longer than this ends any frame
+#define MAX_ZEROES (END_PULSE_SAMPLES + 10)
+
+// Pulse detector state, one per sample stream
+typedef struct {
+  uint8_t zeroes;      // Number of consequtive zeroes
+  uint8_t ones;        // Number of consequtive ones
+#if SYNC_CORRELATE
+  uint64_t history;    // Latest samples, the latest in bit 0
+  uint8_t framed;      // Events since the last SYNC, 0 after a PAUSE or INVALID (no frame under way)
+#endif
+#if CLOCK_RECOVERY
+  uint16_t split;      // Boundary between short and long low pulses of the current frame, 0 until a SYNC is seen
+  uint16_t sum;        // Sum of the low pulses after the SYNC, to refine the boundary
+  uint8_t lows;        // Number of low pulses in the sum
+#endif
+} pulse_detector_t;
+
+#if CLOCK_RECOVERY
+// With clock recovery the pulses are compared against the boundary between short and long low pulses of the
+// current frame (split, nominally 750us). Apart from the SYNC window and END, these are the only timings needed:
+//   high:  split/8 .. split/2
+//   short: split/4 .. split
+//   long:  split .. 2 * split
+// The same functions classify sample counts and widths in us, only the SYNC window passed in differs.
+
+static_assert(MAX_ZEROES < 256, "Sample interval too short: pulses do not fit the pulse counters");
+
+/**
+ * Classification of a high pulse against the clock of the current frame
+ */
+static inline uint8_t clockHigh(const pulse_detector_t *pd, uint16_t width) {
+  if(width > (pd->split >> 1)) return EVENT_INVALID;
+  if(width >= (pd->split >> 3)) return EVENT_HIGH_SHORT;
+  return EVENT_NONE;
+}
+
+/**
+ * Restart the clock from the width of a SYNC: 5/16 of it, nominally 780us
+ */
+static inline void clockSync(pulse_detector_t *pd, uint16_t width) {
+  pd->split = (width * 5) >> 4;
+  pd->sum = 0;
+  pd->lows = 0;
+}
+
+/**
+ * Classification of a low pulse against the clock of the current frame. A SYNC sets the clock from its own width;
+ * the first data lows after it refine the clock. Until the first SYNC the boundary is 0 and only a SYNC is recognized.
+ */
+static inline uint8_t clockLow(pulse_detector_t *pd, uint16_t width, uint16_t sync_min, uint16_t sync_max) {
+  uint8_t event;
+
+  // The SYNC window does not depend on the clock, a SYNC always restarts it
+  if(width >= sync_min && width <= sync_max) {
+    clockSync(pd, width);
+    return EVENT_SYNC;
+  }
+
+  if(width > (pd->split << 1)) {
+    return EVENT_NONE;
+  } else if(width > pd->split) {
+    event = EVENT_LOW_LONG;
+  } else if(width >= (pd->split >> 2)) {
+    event = EVENT_LOW_SHORT;
+  } else {
+    return EVENT_NONE;
+  }
+
+  // A short and a long low average to the boundary between them: use their average once enough are seen
+  if(pd->lows < CLOCK_LEARN_LOWS) {
+    pd->sum += width;
+    if(++pd->lows == CLOCK_LEARN_LOWS) pd->split = pd->sum / CLOCK_LEARN_LOWS;
+  }
+  return event;
+}
+
+/**
+ * Classification of a high run of n samples, reported at the falling edge which ends it
+ */
+static inline uint8_t classifyHighRun(const pulse_detector_t *pd, uint8_t n) {
+  return clockHigh(pd, n);
+}
+
+/**
+ * Classification of a low run of n samples, reported at the rising edge which ends it
+ */
+static inline uint8_t classifyLowRun(pulse_detector_t *pd, uint8_t n) {
+  return clockLow(pd, n, SYNC_SAMPLES_MIN, SYNC_SAMPLES_MAX);
+}
+
+// Highest number of ones in a valid high pulse
+#define HIGH_MAX(pd) ((pd)->split >> 1)
+#else
+#ifndef ARDUINO
+// The host has no separate program memory
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#endif
+
+/**
+ * Classification of a low pulse of n samples, reported at the rising edge which ends it
+ */
+static constexpr uint8_t classifyLow(uint8_t n) {
+  return (n >= SHORT_LOW_PULSE_SAMPLES - FUZZY_SAMPLES_SHORT && n <= SHORT_LOW_PULSE_SAMPLES + FUZZY_SAMPLES_SHORT) ? EVENT_LOW_SHORT :
+         (n >= LONG_PULSE_SAMPLES - FUZZY_SAMPLES_LONG && n <= LONG_PULSE_SAMPLES + FUZZY_SAMPLES_LONG)         ? EVENT_LOW_LONG :
+         (n >= START_PULSE_SAMPLES - FUZZY_SAMPLES_LONG && n <= START_PULSE_SAMPLES + FUZZY_SAMPLES_LONG)       ? EVENT_SYNC :
+                                                                                                                EVENT_NONE;
+}
+
+/**
+ * Classification of a high pulse of n samples, reported at the falling edge which ends it (or as soon as it
+ * is too long)
+ */
+static constexpr uint8_t classifyHigh(uint8_t n) {
+  return n > SHORT_HIGH_PULSE_SAMPLES + FUZZY_SAMPLES_SHORT  ? EVENT_INVALID :
+         n >= SHORT_HIGH_PULSE_SAMPLES - FUZZY_SAMPLES_SHORT ? EVENT_HIGH_SHORT :
+                                                               EVENT_NONE;
+}
+
+// Pulse classification table indexed by the run length: the event for a high run in the upper nibble and
+// the event for a low run in the lower nibble. All event codes fit in 4 bits.
+#define PULSE_CLASS(n)     ((uint8_t)((classifyHigh(n) << 4) | classifyLow(n)))
+#define PULSE_CLASS_2(n)   PULSE_CLASS(n),     PULSE_CLASS((n) + 1)
+#define PULSE_CLASS_4(n)   PULSE_CLASS_2(n),   PULSE_CLASS_2((n) + 2)
+#define PULSE_CLASS_8(n)   PULSE_CLASS_4(n),   PULSE_CLASS_4((n) + 4)
+#define PULSE_CLASS_16(n)  PULSE_CLASS_8(n),   PULSE_CLASS_8((n) + 8)
+#define PULSE_CLASS_32(n)  PULSE_CLASS_16(n),  PULSE_CLASS_16((n) + 16)
+#define PULSE_CLASS_64(n)  PULSE_CLASS_32(n),  PULSE_CLASS_32((n) + 32)
+#define PULSE_CLASS_128(n) PULSE_CLASS_64(n),  PULSE_CLASS_64((n) + 64)
+#define PULSE_TABLE_SIZE 128
+
+static_assert(EVENT_PAUSE < 16, "Event codes must fit in a nibble");
+static_assert(MAX_ZEROES < PULSE_TABLE_SIZE, "Sample interval too short: pulses do not fit the classification table");
+
+static constexpr uint8_t pulse_table[PULSE_TABLE_SIZE] PROGMEM = { PULSE_CLASS_128(0) };
+
+/**
+ * Classification of a high run of n samples, reported at the falling edge which ends it
+ */
+static inline uint8_t classifyHighRun(const pulse_detector_t *, uint8_t n) {
+  return pgm_read_byte(&pulse_table[n]) >> 4;
+}
+
+/**
+ * Classification of a low run of n samples, reported at the rising edge which ends it
+ */
+static inline uint8_t classifyLowRun(pulse_detector_t *, uint8_t n) {
+  return pgm_read_byte(&pulse_table[n]) & 0xF;
+}
+
+// Highest number of ones in a valid high pulse
+#define HIGH_MAX(pd) (SHORT_HIGH_PULSE_SAMPLES + FUZZY_SAMPLES_SHORT)
+#endif
+
+#if SYNC_CORRELATE
+// The samples before an edge which have to match the SYNC
+#define SYNC_WINDOW_MASK (SYNC_CORRELATE_WINDOW < 64 ? ((uint64_t)1 << SYNC_CORRELATE_WINDOW) - 1 : ~(uint64_t)0)
+
+/**
+ * Add a run of n samples of the same level to the history
+ */
+static inline void historyRun(pulse_detector_t *pd, uint8_t level, uint32_t n) {
+  if(n >= 64) {
+    pd->history = level ? ~(uint64_t)0 : 0;
+  } else {
+    pd->history = (pd->history << n) | (level ? ((uint64_t)1 << n) - 1 : 0);
+  }
+}
+
+/**
+ * SYNC correlation at the rising edge which ends a low pulse of n samples. When the window before the edge is low
+ * apart from a few single flipped samples (a high pulse of the data is longer), the low is a SYNC broken up by noise.
+ * @param history the samples up to the edge, the last one in bit 0
+ * @param event the low pulse classified by its length
+ * @param unit sample length in the unit of the clock: 1 when the clock counts samples, the interval for us
+ * @return the event for the low pulse
+ */
+static inline uint8_t correlateSync(pulse_detector_t *pd, uint64_t history, uint32_t n, uint8_t event, uint16_t unit) {
+  // A low as long as the window is a SYNC or not by its length alone; a frame with a symbol keeps going
+  if(event == EVENT_SYNC || event == EVENT_PAUSE || n >= SYNC_CORRELATE_WINDOW || pd->framed > 4) return event;
+
+  uint64_t window = history & SYNC_WINDOW_MASK;
+  if((window & (window >> 1)) || __builtin_popcountll(window) > SYNC_CORRELATE_FLIPS) return event;
+
+#if CLOCK_RECOVERY
+  // The SYNC reaches back to the first high sample before the window, or beyond the history
+  uint64_t before = SYNC_CORRELATE_WINDOW < 64 ? history >> (SYNC_CORRELATE_WINDOW & 63) : 0;
+  uint8_t width = before ? SYNC_CORRELATE_WINDOW + __builtin_ctzll(before) : 64;
+  clockSync(pd, MIN(MAX(width, SYNC_SAMPLES_MIN), SYNC_SAMPLES_MAX) * unit);
+#else
+  // The fixed windows do not learn from the SYNC
+  (void)unit;
+#endif
+  return EVENT_SYNC;
+}
+
+/**
+ * Follow the frames as the frame decoder sees them: from a SYNC to a PAUSE or an INVALID
+ * @return the event
+ */
+static inline uint8_t frameEvent(pulse_detector_t *pd, uint8_t event) {
+  if(event == EVENT_SYNC) {
+    pd->framed = 1;
+  } else if(event == EVENT_PAUSE || event == EVENT_INVALID) {
+    pd->framed = 0;
+  } else if(event != EVENT_NONE && pd->framed && pd->framed < 0xFF) {
+    pd->framed++;
+  }
+  return event;
+}
+#endif
+
+/**
+ * Reset the pulse detector state
+ */
+static inline void detector_init(pulse_detector_t *pd) {
+  pd->zeroes = 0;
+  pd->ones = 0;
+#if SYNC_CORRELATE
+  pd->history = 0;
+  pd->framed = 0;
+#endif
+#if CLOCK_RECOVERY
+  pd->split = 0;
+  pd->sum = 0;
+  pd->lows = 0;
+#endif
+}
+
+/**
+ * Pulse detection on one sample, see detectPulse()
+ */
+static inline uint8_t samplePulse(pulse_detector_t *pd, uint8_t val) {
+  uint8_t event;
+#if SYNC_CORRELATE
+  // Shift the sample into the history; an addition, which avr-gcc does inline unlike a 64 bit shift
+  uint64_t history = pd->history;
+  pd->history = history + history + val;
+#endif
+
+  // High pulse detection
+  if(val == 1) {
+    uint8_t last_zeroes = pd->zeroes;
+    // Reset the zero count and count the ones (up to the table size, the last entry is INVALID)
+    pd->zeroes = 0;
+    if(pd->ones < MAX_ZEROES) pd->ones++;
+    
+    // Low pulse detection: SYNC, SHORT and LONG low pulse types are embedded between SHORT HIGH pulses
+    if(last_zeroes != 0) {
+#if SYNC_CORRELATE
+      return correlateSync(pd, history, last_zeroes, classifyLowRun(pd, last_zeroes), 1);
+#else
+      return classifyLowRun(pd, last_zeroes);
+#endif
+    }
+
+    // Too many ones, this is garbage - report it right away instead of waiting for the end of the pulse
+    if(pd->ones > HIGH_MAX(pd)) {
+      return EVENT_INVALID;
+    }
+
+    return EVENT_NONE;
+  } else {
+    // Short high pulse detection at the falling edge (too long pulses were reported already)
+    event = EVENT_NONE;
+    if(pd->ones != 0) {
+      event = classifyHighRun(pd, pd->ones);
+      if(event != EVENT_HIGH_SHORT) event = EVENT_NONE;
+      pd->ones = 0;
+    }
+
+    // Low pulse detection, when more low pulses than the SYNC + SHORT pulse is seen - it is usually an end of a frame
+    // Sanity: make sure to only count when it makes sense and skip computations once we go beyond a certain number of zeroes
+    if(pd->zeroes < MAX_ZEROES) {
+      pd->zeroes++;
+    
+      if(pd->zeroes == END_PULSE_SAMPLES) {
+        // Very long pause - this has to be the end of a frame
+        return EVENT_PAUSE;
+      }
+    } else {
+      // Too many zeroes - this is between frames or noise
+      return EVENT_INVALID;
+    }
+    
+    return event;
+  }
+}
+
 /**
  * Utility function to detect various pulse types; works on a sample stream so we do not need to store a lot of samples while decoding the stream.
  *
  * @return the event code for the current sample given
  */
-uint8_t detectPulse(uint8_t val);
+static inline uint8_t detectPulse(pulse_detector_t *pd, uint8_t val) {
+#if SYNC_CORRELATE
+  return frameEvent(pd, samplePulse(pd, val));
+#else
+  return samplePulse(pd, val);
+#endif
+}
+
+/**
+ * Classification of a completed pulse by its length in samples, see detectRun()
+ */
+static inline uint8_t runPulse(pulse_detector_t *pd, uint8_t level, uint32_t samples) {
+  if(level) {
+    // Anything longer than the counters is too long for a short high pulse as well
+    return classifyHighRun(pd, MIN(samples, MAX_ZEROES));
+  }
+
+  // A low pulse turns into a PAUSE once it is long enough, whatever follows
+  if(samples >= END_PULSE_SAMPLES) return EVENT_PAUSE;
+#if SYNC_CORRELATE
+  return correlateSync(pd, pd->history, samples, classifyLowRun(pd, samples), 1);
+#else
+  return classifyLowRun(pd, samples);
+#endif
+}
+
+/**
+ * Classify a completed pulse by its length in samples, for input sources which deliver run lengths instead of
+ * single samples. Produces the same events as detectPulse() for the same samples.
+ *
+ * @param level the level of the pulse that just ended
+ * @param samples length of the pulse in samples
+ * @return the event code for the pulse
+ */
+static inline uint8_t detectRun(pulse_detector_t *pd, uint8_t level, uint32_t samples) {
+#if SYNC_CORRELATE
+  historyRun(pd, level, samples);
+  return frameEvent(pd, runPulse(pd, level, samples));
+#else
+  return runPulse(pd, level, samples);
+#endif
+}
+
+/**
+ * Classification of a completed pulse by its measured width
+ */
+static inline uint8_t classifyEdge(pulse_detector_t *pd, uint8_t level, uint16_t duration_us) {
+#if CLOCK_RECOVERY
+  if(level) return clockHigh(pd, duration_us);
+
+  // Very long pause - this has to be the end of a frame
+  if(duration_us >= END_PULSE_US) return EVENT_PAUSE;
+  return clockLow(pd, duration_us, SYNC_US_MIN, SYNC_US_MAX);
+#else
+  (void)pd;
+  if(level) {
+    // Only short high pulses are part of the protocol
+    if(duration_us > SHORT_HIGH_PULSE_US_MAX) return EVENT_INVALID;
+    if(duration_us >= SHORT_HIGH_PULSE_US_MIN) return EVENT_HIGH_SHORT;
+    // Glitch - too short to be a pulse, ignored just like the sampled path does
+    return EVENT_NONE;
+  }
+
+  // Low pulse detection - from short to long
+  if(duration_us >= SHORT_LOW_PULSE_US_MIN && duration_us <= SHORT_LOW_PULSE_US_MAX) return EVENT_LOW_SHORT;
+  if(duration_us >= LONG_PULSE_US_MIN && duration_us <= LONG_PULSE_US_MAX) return EVENT_LOW_LONG;
+  if(duration_us >= START_PULSE_US_MIN && duration_us <= START_PULSE_US_MAX) return EVENT_SYNC;
+  // Very long pause - this has to be the end of a frame
+  if(duration_us >= END_PULSE_US) return EVENT_PAUSE;
+
+  return EVENT_NONE;
+#endif
+}
+
+/**
+ * Classify a completed pulse by its measured width, for input sources which time the edges instead of sampling
+ * the receiver. Uses the same windows as detectPulse() so both paths produce the same event stream.
+ *
+ * @param level the level of the pulse that just ended
+ * @param duration_us width of the pulse in us
+ * @return the event code for the pulse
+ */
+static inline uint8_t detectEdge(pulse_detector_t *pd, uint8_t level, uint16_t duration_us) {
+#if SYNC_CORRELATE
+  // The correlation works on samples, the pulse goes into the history rounded to whole samples
+  uint32_t samples = (duration_us + RX_SAMPLE_INTERVAL_US / 2) / RX_SAMPLE_INTERVAL_US;
+  historyRun(pd, level, samples);
+  uint8_t event = classifyEdge(pd, level, duration_us);
+  if(!level) event = correlateSync(pd, pd->history, samples, event, RX_SAMPLE_INTERVAL_US);
+  return frameEvent(pd, event);
+#else
+  return classifyEdge(pd, level, duration_us);
+#endif
+}
 
 #endif
- 
@@ -3,14 +3,35 @@
 // Configure the design
 void setup() {
   // Enable serial debugging
-  Serial.begin(9600);
+  #if (ENABLE_RECORDER && RECORDER_STREAM) || (ENABLE_DEBUG_DECODER && DEBUG_TRACE)
+  Serial.begin(SERIAL_BAUD_STREAM);
+  #else
+  Serial.begin(SERIAL_BAUD);
+  #endif
   
   // Configure the pins used by this program
   pinMode(txPin, OUTPUT);
   pinMode(rxPin, INPUT);
+  #if RX_MULTI
+  RX_MULTI_DDR &= ~RX_MULTI_MASK;
+  #endif
+  
+  // Timer1 compare interrupt for sending packets in the background
+  #if ENABLE_TRANSMITTER
+  tx_start();
+  #endif
+
+  // Outputs of the packet handlers
+  #if ENABLE_DISPATCH
+  devices_init();
+  #endif
   
   // Speed up the ADC so it can keep up
+  #if RX_ANALOG && (RX_ANALOG_FREERUN || RX_OVERSAMPLE)
+  adc_start_freerun(rxPinAna);
+  #else
   set_ADC_speed();
+  #endif
   
   Serial.print("Nexa RF - ");
   #if ENABLE_FULL_DECODER
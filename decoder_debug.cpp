@@ -1,11 +1,108 @@
 
 #include "decoder.h"
+// Symbol patterns
+#include "protocols.h"
 // Load the project config
 #include "config.h"
 
+#if RX_TIMER_SAMPLER && defined(ARDUINO)
+// Samples from the timer interrupt
+#include "timer_sampler.h"
+#elif defined(ARDUINO)
+// The receiver input as a sample source
+#include "receiver.h"
+#endif
+
 // Only implement the functions when this module is enabled
 #if ENABLE_DEBUG_DECODER
 
+// Pulse detector state for the receiver
+pulse_detector_t detector;
+
+#if DEBUG_TRACE
+// Binary trace records and the ring they wait in
+#include "trace.h"
+#include "ring.h"
+
+// Records waiting to be written: the sample loop fills the ring and writes it out in its slack time
+static ring_t trace;
+static trace_pulse_t pulse;
+static uint32_t traced = 0;    // Samples taken, the ones of lost records included
+static uint32_t lost = 0;      // Samples of the records lost since the last dropped record
+static uint8_t records = 0;    // Records since the last time record
+
+/**
+ * Add a record to the ring, or count its samples as lost when it does not fit. The lost samples go out first once
+ * there is room again, so the time of the records after them stays right.
+ */
+static void traceRecord(const uint8_t *rec, uint8_t size, uint32_t samples) {
+  uint8_t buf[TRACE_RECORD_MAX];
+
+  while(lost && ring_space(&trace) >= TRACE_RECORD_MAX + size) {
+    uint32_t n = MIN(lost, TRACE_MAX_RUN);
+    uint8_t len = trace_put_dropped(buf, n);
+    for(uint8_t i = 0; i < len; i++) ring_push(&trace, buf[i]);
+    lost -= n;
+  }
+
+  if(lost || ring_space(&trace) < size) {
+    lost += samples;
+    return;
+  }
+  for(uint8_t i = 0; i < size; i++) ring_push(&trace, rec[i]);
+}
+
+/**
+ * Trace logic: process captured sample and record the pulse once it is complete
+ */
+static inline void pushSample(uint8_t val) {
+  uint8_t rec[TRACE_RECORD_MAX];
+  uint8_t size = trace_sample(&pulse, val, detectPulse(&detector, val), rec);
+
+  if(!size) return;
+
+  if(++records == DEBUG_TRACE_TIME_RECORDS) {
+    uint8_t buf[TRACE_RECORD_MAX];
+    records = 0;
+    traceRecord(buf, trace_put_time(buf, traced), 0);
+  }
+  traceRecord(rec, size, pulse.ended);
+  traced += pulse.ended;
+}
+
+/**
+ * Samples which were never seen, reported as lost. The pulse being traced is recorded up to the gap first, so its
+ * samples keep their time; the rest of it continues after the gap.
+ */
+static inline void traceLost(uint32_t samples) {
+  uint8_t rec[TRACE_RECORD_MAX];
+  uint8_t size = trace_flush(&pulse, rec);
+
+  if(size) {
+    traceRecord(rec, size, pulse.ended);
+    traced += pulse.ended;
+  }
+  lost += samples;
+  traced += samples;
+}
+
+/**
+ * Write a little of the trace, as much as fits in the serial transmit buffer
+ */
+static inline void traceDrain() {
+  uint8_t b;
+  for(uint8_t n = 0; n < DEBUG_TRACE_SLICE_BYTES && Serial.availableForWrite() > 0 && ring_pop(&trace, &b); n++) {
+    Serial.write(b);
+  }
+}
+
+/**
+ * Check if records are waiting; text must wait until they are written so it does not end up inside a record
+ */
+static inline uint8_t tracePending() {
+  return ring_count(&trace) != 0;
+}
+#else
 #define MAX_BITS 192
 
 // Buffers to hold the decoded bits
@@ -66,21 +163,17 @@ void decodePacket() {
     
     // Do a pattern match if at least 4 symbols are available
     if(bitPtr - i > 4) {
-      if( bits[i  ] == EVENT_HIGH_SHORT &&
-          bits[i+1] == EVENT_LOW_LONG   &&
-          bits[i+2] == EVENT_HIGH_SHORT &&
-          bits[i+3] == EVENT_LOW_SHORT) {
-        // Pattern: hLhl = 1, shift a 1 into the data buffer
-        raw <<= 1;
-        raw |= 1;
-        bitcnt++;
-      } else if(
-          bits[i  ] == EVENT_HIGH_SHORT &&
-          bits[i+1] == EVENT_LOW_SHORT  &&
-          bits[i+2] == EVENT_HIGH_SHORT &&
-          bits[i+3] == EVENT_LOW_LONG) {
-        // Pattern hlhL = 0, shift a 0 into the data buffer
+      uint8_t value = SYMBOL_INVALID;
+      if(bits[i  ] == EVENT_HIGH_SHORT && (bits[i+1] == EVENT_LOW_SHORT || bits[i+1] == EVENT_LOW_LONG) &&
+         bits[i+2] == EVENT_HIGH_SHORT && (bits[i+3] == EVENT_LOW_SHORT || bits[i+3] == EVENT_LOW_LONG)) {
+        // The lengths of the two lows give the value, see protocols.h
+        value = nexa_protocol::symbol(((bits[i+1] == EVENT_LOW_LONG) << 1) | (bits[i+3] == EVENT_LOW_LONG), bitcnt);
+      }
+
+      if(value != SYMBOL_INVALID) {
+        // Shift the bit into the data buffer
         raw <<= 1;
+        raw |= value;
         bitcnt++;
       } else {
         Serial.print("Invalid pulse pattern at event ");
@@ -151,7 +244,7 @@ static inline void pushSample(uint8_t val) {
   uint8_t doPrint = 0;
   
   // Begin with event detection
-  uint8_t event = detectPulse(val);
+  uint8_t event = detectPulse(&detector, val);
   
   // Event recording: store each event type
   switch(event) {
@@ -205,46 +298,140 @@ static inline void pushSample(uint8_t val) {
   
   last_event = event;
 }
+#endif
 
+#if RX_TIMER_SAMPLER
 /**
- * When the code takes to long, the recorded data stream is useless - print a warning and continue.
- * Note: this is expected to happen during debug printouts
+ * Timer sampler decoder loop: the timer interrupt samples on a fixed grid, so the printouts no longer lose samples
+ * as long as they finish before the ring is full
  */
-void print_timeout(unsigned long dur) {
-  Serial.print("Error: could not compensate for computation time.\nDuration in us: ");
-  Serial.print(dur);
-  Serial.print("\nTarget in us: ");
-  Serial.println(RX_SAMPLE_INTERVAL_US);
-}
+void debug_decoder_loop() {
+  uint8_t samples;
+  uint16_t overruns = 0;
+#if DEBUG_TRACE
+  uint32_t gap = 0;          // Samples lost to overruns and not traced yet
+  uint8_t gap_after = 0;     // Bytes to trace before them
+#endif
 
+  detector_init(&detector);
+#if DEBUG_TRACE
+  ring_init(&trace);
+  trace_init(&pulse);
+#endif
+  sampler_start();
+
+  while(1) {
+    if(!sampler_read(&samples)) {
+#if DEBUG_TRACE
+      // Write the trace while waiting for samples
+      traceDrain();
+#endif
+      continue;
+    }
+
+    uint16_t now = sampler_overruns();
+    if(now != overruns) {
+#if DEBUG_TRACE
+      // The ring was full when the samples were lost, so they come after the bytes waiting in it now
+      if(!gap) gap_after = sampler_pending() + 1;
+      gap += 8UL * (uint16_t)(now - overruns);
+      overruns = now;
+#else
+      overruns = now;
+      Serial.print("Sample overruns: ");
+      Serial.println(overruns);
+#endif
+    }
+
+    // Push the 8 samples into the detection logic, the first one in the most significant bit
+    for(int8_t i = 7; i >= 0; i--) {
+      pushSample((samples >> i) & 0x1);
+    }
+
+#if DEBUG_TRACE
+    // The trace tells the reader where samples are missing
+    if(gap && !--gap_after) {
+      traceLost(gap);
+      gap = 0;
+    }
+#endif
+  }
+}
+#else
 /**
  * Standard decoder loop: read a sample, push it through the detection logic, wait
  */
 void debug_decoder_loop() {
-  unsigned long time, dur, wait;
+  unsigned long time, dur;
+  rx_source_t source;
+#if SAMPLE_LOOP_TIMING
+  // The event printouts are expected to overrun (the trace is not), the counters show how often and by how much
+  static timing_t timing;
+  uint16_t start, read;
+
+  timing_init(&timing);
+  timing_start();
+#endif
+
+  source.begin();
+  detector_init(&detector);
+#if DEBUG_TRACE
+  ring_init(&trace);
+  trace_init(&pulse);
+#endif
 
   while(1) {
     // Grab current time
     time = micros();
     
+#if SAMPLE_LOOP_TIMING
+    // Sample from the antenna and push it into the detection logic, recording the time of both
+    start = timing_now();
+    uint8_t val = source.read();
+    read = timing_now();
+    pushSample(val);
+    timing_stage(&timing, TIMING_READ, read - start);
+    timing_stage(&timing, TIMING_DETECT, timing_now() - read);
+#if DEBUG_TRACE
+    // Write a little of the trace when there is time left
+    dur = micros() - time;
+    if(dur + DEBUG_TRACE_SLICE_US < RX_SAMPLE_INTERVAL_US) {
+      read = timing_now();
+      traceDrain();
+      timing_stage(&timing, TIMING_OUTPUT, timing_now() - read);
+    }
+#endif
+    timing_iteration(&timing, (uint16_t)(timing_now() - start) / TIMING_TICKS_PER_US, RX_SAMPLE_INTERVAL_US);
+
+#if DEBUG_TRACE
+    if(!tracePending() && timing_due()) {
+#else
+    if(timing_due()) {
+#endif
+      timing_report(&timing);
+      continue;
+    }
+#else
     // Sample from the antenna
-    uint8_t val = readRxPin();
+    uint8_t val = source.read();
     
     // Push the sample into the detection logic
     pushSample(val);
+#if DEBUG_TRACE
+    // Write a little of the trace when there is time left
+    dur = micros() - time;
+    if(dur + DEBUG_TRACE_SLICE_US < RX_SAMPLE_INTERVAL_US) traceDrain();
+#endif
+#endif
     
-    // Correct time offset due to computations
+    // Correct time offset due to computations, when too slow carry on right away
     dur = micros() - time;
-    if(dur > RX_SAMPLE_INTERVAL_US) print_timeout(dur);
-    wait = RX_SAMPLE_INTERVAL_US - dur;
-    // Overflow protection
-    //if(wait > RX_SAMPLE_INTERVAL_US) break;
+    if(dur >= RX_SAMPLE_INTERVAL_US) continue;
     
     // Wait for the next sampling point
-    delayMicroseconds(wait);
+    delayMicroseconds(RX_SAMPLE_INTERVAL_US - dur);
   }
-  
-
 }
+#endif
 
 #endif
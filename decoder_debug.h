@@ -5,6 +5,20 @@
 #ifndef _DECODER_DEBUG_H_
 #define _DECODER_DEBUG_H_
 
+// When set to 1, stream every pulse with the event it produced as a binary trace (see trace.h) instead of printing
+// the events of a frame. The trace goes through a ring and is written in the slack time of the sample loop, so the
+// sample loop keeps its timing; records which do not fit in the ring are counted and reported in the trace. The
+// host viewer (host/tracedump) shows the events and decodes the frames. The serial port runs at SERIAL_BAUD_STREAM
+// then and the output is binary, readable with host/tracedump only.
+#define DEBUG_TRACE 0
+
+// Trace bytes written per step at most, and the slack needed in the sample interval for one step, in us
+#define DEBUG_TRACE_SLICE_BYTES 2
+#define DEBUG_TRACE_SLICE_US 10
+
+// Records between time records, for a reader which starts in the middle of the stream
+#define DEBUG_TRACE_TIME_RECORDS 64
+
 /**
  * Debug decoder loop: read a sample, push it through the detection logic, wait - every now and then a printout is done to show the state of the recorded samples
  */
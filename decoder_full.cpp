@@ -1,239 +1,292 @@
 
-// Function prototypes for this file
+// Decoder stages and the prototype of the loop
 #include "decoder_full.h"
-// Shared decoder functions
-#include "decoder.h"
 // Load the project config
 #include "config.h"
 
-// Only implement the functions when this module is enabled
-#if ENABLE_FULL_DECODER
+#ifdef ARDUINO
+// Packets are written in the slack time of the sample loop
+#include "output.h"
+#endif
 
-#define PAYLOAD_SIZE_BITS 32                          // Payload size - standard Nexa packet contains 32 bits
-#define PAYLOAD_BYTES ((PAYLOAD_SIZE_BITS-1) / 8 + 1) // Complicated way of dividing by 8 and rounding up
+#if RX_CAPTURE && defined(ARDUINO)
+// Edge timing input and sleeping while idle
+#include "capture.h"
+#include <avr/sleep.h>
+#endif
 
-union {
-  uint32_t    raw;
-  nexa_pckt_t pkt;
-} buf;
+#if RX_TIMER_SAMPLER && defined(ARDUINO)
+// Samples from the timer interrupt
+#include "timer_sampler.h"
+#endif
 
-uint32_t prev_pkt_raw;       // Previous raw packet received - used to detect when repeats occur within a number of sampling periods
-uint32_t prev_pkt_cnt;       // Counter since last packet was decoded, when it reaches 0 after starting from REPEAT_IGNORE_SAMPLES the value of prev_pkt_raw is erased to support receiving it again
+#if !RX_CAPTURE && !RX_TIMER_SAMPLER && !RX_MULTI && defined(ARDUINO)
+// The sample loop is a receiver reading the configured input
+#include "receiver.h"
+#endif
 
-// Repeat interval in which identical packets are ignored after first reception: each bit consists of 3 short and 1 long pulse, 32 bits, plus start and sync, repeated 5 to 6 times.
-#define SAMPLES_PER_BIT        ( SHORT_HIGH_PULSE_SAMPLES * 2 + SHORT_LOW_PULSE_SAMPLES + LONG_PULSE_SAMPLES )
-#define REAL_PAUSE_SAMPLES     (END_PULSE_SAMPLES * 5)  // The real pause is longer but to save time its defined 5 times too small
-#define NUM_REPEATS            6
-#define REPEAT_IGNORE_SAMPLES  (((SAMPLES_PER_BIT * PAYLOAD_SIZE_BITS) + START_PULSE_SAMPLES + REAL_PAUSE_SAMPLES) * NUM_REPEATS)
+// Only implement the sample loops when this module is enabled, the decoder stages are in decoder_full.h
+#if ENABLE_FULL_DECODER && defined(ARDUINO)
+#if RX_CAPTURE || RX_TIMER_SAMPLER
+// Decoder state for the receiver
+static nexa_decoder_t decoder;
+#endif
 
-// Clever macro to generate code which causes a compiler error when the condition does not hold
-#define BUILD_BUG_ON(condition) ((void)sizeof(char[1 - 2*!!(condition)]))
+#if SAMPLE_LOOP_TIMING && !RX_CAPTURE && !RX_TIMER_SAMPLER
+// Counters of the sample loop
+static timing_t timing;
 
-uint8_t eventbuf[4];         // Event buffer - each bit consists of 4 pulse events, or 2 events for the frame ending
-uint8_t ep = 0;              // Event pointer, set to the location of the next event insertion point
-uint8_t seqval = 0;          // Event sequence valid, set to 0 when unexpected sequences are detected
-uint8_t dbit = 0;            // Data bit pointer, valid as long as its smaller than 32
+/**
+ * decodeSample() with the time of each stage recorded
+ */
+static inline uint8_t decodeSampleTimed(nexa_decoder_t *d, uint8_t sample) {
+  uint16_t t0 = timing_now();
+#if SOFT_DECODE
+  d->now++;
+#endif
+  uint8_t event = detectPulse(&d->detector, sample);
+  uint16_t t1 = timing_now();
+  uint8_t res = assemble(d, event);
+  uint16_t t2 = timing_now();
+  res = debounce(d, res);
+  uint16_t t3 = timing_now();
 
-// Check the size of some things using a clever preprocessor trick that generates compiler errors if some condition does not hold
-// Note: do not call this function as will not result in any instructions when compiled (so it only adds size)
-inline void sanityCheck() {
-  BUILD_BUG_ON(sizeof(buf) != PAYLOAD_BYTES);
+  timing_stage(&timing, TIMING_DETECT, t1 - t0);
+  timing_stage(&timing, TIMING_FRAME, t2 - t1);
+  timing_stage(&timing, TIMING_DEBOUNCE, t3 - t2);
+  return res;
 }
+#endif
 
 /**
- * Invalidate the current packet (if any)
+ * In binary mode, count the repeats of the newest packet of a debouncer
  */
-inline void invalidate() {
-  ep = 0;     // when invalid pulses or sequences of pulses are detected, reset the event pointer
-  seqval = 0; // mark the whole sequence invalid
-  dbit = 0;   // Set the data buffer to begin over
+static inline void queueRepeats(const dedup_t *dedup) {
+#if OUTPUT_BINARY
+  static uint8_t repeats = 1;
+  const dedup_entry_t *e = dedup_last(dedup);
+  if(e->repeats != repeats) {
+    repeats = e->repeats;
+    output_repeats(e->raw, repeats);
+  }
+#else
+  (void)dedup;
+#endif
 }
 
+#if RX_CAPTURE || RX_TIMER_SAMPLER
 /**
- * Push a bit in the data buffer. Returns 0 when no space is left in the buffer.
+ * Queue a new packet for output; in binary mode also count the repeats of the newest one
  */
-inline uint8_t pushBit(uint8_t bitVal) {
-  if(dbit < PAYLOAD_SIZE_BITS) {
-    buf.raw = (buf.raw << 1) | (bitVal & 0x1); // Shift a single bit into the buffer
-    dbit++;
-    return 1; // True: bit added
+static inline void queuePacket(uint8_t res) {
+  if(res) {
+#if ENABLE_DISPATCH
+    devices_dispatch(lastPacket(&decoder));
+#endif
+    output_push(lastPacket(&decoder), dedup_last(&decoder.dedup)->time_ms);
+    return;
   }
-  return 0; // False: overflow
+  queueRepeats(&decoder.dedup);
 }
+#endif
 
+#if RX_CAPTURE
 /**
- * Standard decoder logic: process captured sample and process the event stream that results from it.
- * Once a valid packet has been detected, the packet decoder is called to respond to the NEXA command.
- * @return 0 for no result, 1 for packet received in *data
+ * Edge decoder loop: the input capture interrupt times the pulses, decode them as they come in and sleep otherwise
  */
-static inline int8_t pushSample(uint8_t val) {
-  // Begin with event detection
-  uint8_t event = detectPulse(val);
-
-  // Boot mode: find the start of a packet
-  if(seqval == 0) {
-    if(event == EVENT_SYNC) {
-      // Sync pulse found - start of a new packet
-      seqval = 1; // mark the sequence valid to start with
+void decoder_loop() {
+  uint8_t level;
+  uint16_t duration;
+
+  // Init the decoder and the debouncer
+  decoder_init(&decoder);
+
+  capture_start();
+
+  while(1) {
+    // Decode all queued pulses - when a whole packet is received, it will return true
+    while(capture_read(&level, &duration)) {
+      queuePacket(decodeEdge(&decoder, level, duration));
     }
-    
-    return 0; // Without a valid sequence - stop processing here
-  } else {
-    // Decoding mode: decoding a packet
-    switch(event) {
-      case EVENT_NONE:
-        // Inter-event samples, ignore
-        return 0; // Stop processing for this event
-        break;
-      case EVENT_HIGH_SHORT:
-      case EVENT_LOW_SHORT:
-      case EVENT_LOW_LONG:
-        // Normal events during a packet - add to event buffer
-        eventbuf[ep++] = event;
-        break;
-      case EVENT_SYNC:
-        // New sync detected, invalidate previous results and start over
-        invalidate();
-        seqval = 1;   // Mark the sequence as valid again as this might be the start of a correct packet
-        return 0;     // Stop processing for this event
-        break;
-      case EVENT_PAUSE:
-        // Marks the completion of the packet - this event is used down below so do not act here
-        break;
-      case EVENT_INVALID:
-        invalidate();
-        return 0; // Stop processing for this event
-        break;
+
+    // Write the packets a little at a time, new pulses go first
+    if(output_pending()) {
+      output_drain();
+      continue;
     }
-  }
 
-  // When the event buffer is full, see if a valid bit pattern was received
-  if(ep == 4) {
-    // Reset event pointer (before jumping out of this function)
-    ep = 0;
-    
-    if(eventbuf[0] == EVENT_HIGH_SHORT && 
-       eventbuf[1] == EVENT_LOW_SHORT  && 
-       eventbuf[2] == EVENT_HIGH_SHORT && 
-       eventbuf[3] == EVENT_LOW_LONG) {
-       // Pattern: hlhL = 1, shift a 0 into the data buffer
-       if(!pushBit(0)) {
-         // On a buffer overflow, mark the whole packet as invalid
-         invalidate();
-         return 0;
-       }
-    } else if(
-       eventbuf[0] == EVENT_HIGH_SHORT && 
-       eventbuf[1] == EVENT_LOW_LONG   && 
-       eventbuf[2] == EVENT_HIGH_SHORT && 
-       eventbuf[3] == EVENT_LOW_SHORT) {
-       // Pattern: hLhl = 1, shift a 1 into the data buffer
-       if(!pushBit(1)) {
-         // On a buffer overflow, mark the whole packet as invalid
-         invalidate();
-         return 0;
-       } 
-    } else {
-      // Anything else is an error and invalidates the whole reception
-      invalidate();
-      return 0; // Stop processing for this event
+    // Nothing to do until the next interrupt (edge, timeout or the millis() timer)
+    noInterrupts();
+    if(!capture_pending()) {
+      sleep_enable();
+      interrupts();
+      sleep_cpu();
+      sleep_disable();
     }
+    interrupts();
   }
-  
-  // See if we detected a PAUSE which should complete the packet
-  if(event == EVENT_PAUSE) {
-    if(dbit == PAYLOAD_SIZE_BITS) {
-      // Invalidate the decoder state so a new packet can be received
-      invalidate();
-      
-      // Payload complete
-      return 1;
+}
+#elif RX_TIMER_SAMPLER
+/**
+ * Timer sampler decoder loop: the timer interrupt samples on a fixed grid, decode the samples as they come in
+ */
+void decoder_loop() {
+  uint8_t samples;
+  uint16_t overruns = 0;
+
+  // Init the decoder and the debouncer
+  decoder_init(&decoder);
+
+  sampler_start();
+
+  while(1) {
+    // Write the packets while waiting for samples
+    if(!sampler_read(&samples)) {
+      output_drain();
+      continue;
     }
-  }
 
-  // Nothing to report, return zero
-  return 0;  
-}
+    // Decode the 8 samples, the first one in the most significant bit
+    for(int8_t i = 7; i >= 0; i--) {
+      queuePacket(decodeSample(&decoder, (samples >> i) & 0x1));
+    }
 
-static inline void printTooSlow(unsigned long dur) {
-  Serial.print("Error: could not compensate for computation time.\nDuration in us: ");
-  Serial.print(dur);
-  Serial.print("\nTarget in us: ");
-  Serial.println(RX_SAMPLE_INTERVAL_US);
-  
-//  while(1) {}
+    // Report lost samples when it happens
+    if(sampler_overruns() != overruns) {
+      overruns = sampler_overruns();
+      Serial.print("Sample overruns: ");
+      Serial.println(overruns);
+    }
+  }
 }
+#elif RX_MULTI
+/**
+ * Receiver port decoder loop: read all receivers at once, decode them in parallel, wait
+ */
+void decoder_loop() {
+  static nexa_port_decoder_t port;
+  unsigned long time, dur;
+#if SAMPLE_LOOP_TIMING
+  uint16_t start, read;
 
-static inline uint8_t decodeSample(uint8_t sample) {
-  uint8_t res = pushSample(sample);
-  
-  // If a debouncer is running - count it down
-  if(prev_pkt_cnt > 0) {
-    prev_pkt_cnt--;
-    // Wipe the previously received value if the debouncer reached 0
-    if(prev_pkt_cnt == 0) prev_pkt_raw = 0;
-  }
-  
-  if(res) {
-    // Received a packet - check if it was received before
-    if(prev_pkt_raw == buf.raw) {
-      // It was seen before - drop it
-      return 0;
+  timing_init(&timing);
+  timing_start();
+#endif
+
+  // Init the decoders and the shared debouncer
+  port_decoder_init(&port, RX_MULTI_MASK);
+
+  while(1) {
+    // Grab current time
+    time = micros();
+
+#if SAMPLE_LOOP_TIMING
+    // The detection of all receivers is recorded as one stage, frames and debouncing only run at their edges
+    start = timing_now();
+    uint8_t val = readRxPort();
+    read = timing_now();
+    uint8_t fresh = decodePort(&port, val);
+    timing_stage(&timing, TIMING_READ, read - start);
+    timing_stage(&timing, TIMING_DETECT, timing_now() - read);
+#else
+    uint8_t fresh = decodePort(&port, readRxPort());
+#endif
+
+    // Queue the new packets, the first receiver which heard a packet delivers it
+    if(fresh) {
+      for(uint8_t i = 0; i < PORT_RECEIVERS; i++) {
+        if(!(fresh & (1 << i))) continue;
+#if ENABLE_DISPATCH
+        devices_dispatch(portPacket(&port, i));
+#endif
+        output_push(portPacket(&port, i), millis());
+      }
+    } else {
+      queueRepeats(&port.dedup);
     }
-    
-    // Received new packet, copy it into the debouncer value
-    prev_pkt_raw = buf.raw;
-    // Set the debounce counter so we will not 'receive' this packet in the next time
-    prev_pkt_cnt = REPEAT_IGNORE_SAMPLES;
-  }
 
-  return res;
+    // Write a little of the output when there is time left
+    dur = micros() - time;
+    if(dur + OUTPUT_SLICE_US < RX_SAMPLE_INTERVAL_US) output_drain();
+
+#if SAMPLE_LOOP_TIMING
+    timing_iteration(&timing, (uint16_t)(timing_now() - start) / TIMING_TICKS_PER_US, RX_SAMPLE_INTERVAL_US);
+    if(!output_pending() && timing_due()) {
+      timing_report(&timing);
+      continue;
+    }
+#endif
+
+    // Correct time offset due to computations, an iteration which was too slow is in the counters
+    dur = micros() - time;
+    if(dur >= RX_SAMPLE_INTERVAL_US) continue;
+
+    // Wait for the next sampling point
+    delayMicroseconds(RX_SAMPLE_INTERVAL_US - dur);
+  }
 }
+#else
+// New packets go to the serial port, and with ENABLE_DISPATCH to the handlers of devices.cpp as well
+#if ENABLE_DISPATCH
+typedef both_sinks<serial_sink, dispatch_sink> decoder_sink_t;
+#else
+typedef serial_sink decoder_sink_t;
+#endif
+
+// The receiver: the input picked in sampler.h through the full decoder
+static receiver<rx_source_t, decoder_sink_t> rx;
 
 /**
  * Standard decoder loop: read a sample, push it through the detection logic, wait
  */
 void decoder_loop() {
-  unsigned long time, dur, wait;
-  uint8_t res;
-  
-  // Init the debouncer
-  prev_pkt_raw = 0;
-  prev_pkt_cnt = 0;
+  // Start the input, init the decoder and the debouncer
+  rx.begin();
+
+#if SAMPLE_LOOP_TIMING
+  unsigned long time, dur;
+  uint16_t start, read;
+
+  timing_init(&timing);
+  timing_start();
 
   while(1) {
     // Grab current time
     time = micros();
-    
-    // Sample from the antenna
-    uint8_t val = readRxPin();
-
-    // Decode the sample - when a whole packet is received, it will return true
-    if(res = decodeSample(val)) {
-      // Packet received
-      //Serial.println(buf.raw, HEX);
-      Serial.print(buf.pkt.device_id, HEX);
-      Serial.print(":");
-      Serial.print(buf.pkt.unit, HEX);
-      Serial.print(" group:");
-      Serial.print(buf.pkt.group, HEX);
-      Serial.print(" channel: ");
-      Serial.print(buf.pkt.channel, HEX);
-      Serial.print(" on:");
-      Serial.println(buf.pkt.on_off, HEX);
+
+    // Sample from the antenna and decode the sample, recording the time of every stage
+    start = timing_now();
+    uint8_t val = rx.source.read();
+    read = timing_now();
+    rx.deliver(decodeSampleTimed(&rx.decoder, val));
+    timing_stage(&timing, TIMING_READ, read - start);
+
+    // Write a little of the output when there is time left
+    dur = micros() - time;
+    if(dur + OUTPUT_SLICE_US < RX_SAMPLE_INTERVAL_US) {
+      read = timing_now();
+      rx.sink.idle(RX_SAMPLE_INTERVAL_US - dur);
+      timing_stage(&timing, TIMING_OUTPUT, timing_now() - read);
     }
-    
-    // Correct time offset due to computations
+    timing_iteration(&timing, (uint16_t)(timing_now() - start) / TIMING_TICKS_PER_US, RX_SAMPLE_INTERVAL_US);
+
+    // Reports are rare and not part of the recorded iterations, they wait for a packet line to be complete
+    if(!output_pending() && timing_due()) {
+      timing_report(&timing);
+      continue;
+    }
+
+    // Correct time offset due to computations, an iteration which was too slow is in the counters
     dur = micros() - time;
-    // If there was no packet received (so no serial print) - and the routine is too slow, print something
-    if(!res && dur > RX_SAMPLE_INTERVAL_US) printTooSlow(dur);
-    wait = RX_SAMPLE_INTERVAL_US - dur;
-    // Overflow protection
-    //if(wait > RX_SAMPLE_INTERVAL_US) break;
-    
+    if(dur >= RX_SAMPLE_INTERVAL_US) continue;
+
     // Wait for the next sampling point
-    delayMicroseconds(wait);
+    delayMicroseconds(RX_SAMPLE_INTERVAL_US - dur);
   }
+#else
+  // Sample, decode, write the output in the time left and wait, see receiver::loop()
+  rx.loop();
+#endif
 }
-
+#endif
 #endif
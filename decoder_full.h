@@ -1,10 +1,269 @@
 /**
  * NEXA protocol decoder - full decoder
+ *
+ * The stages after the pulse detector (decoder.h): frame assembly, voting over the repeats and the debouncer, for
+ * one receiver or a port of them. Header only and independent of the module selected in config.h, so receiver.h
+ * and the host tools put them together with any input; decoder_full.cpp holds the sample loops of the module.
  */
 
 #ifndef _DECODER_FULL_H_
 #define _DECODER_FULL_H_
 
+#include <stdint.h>
+
+// Pulse detector state
+#include "decoder.h"
+// Frame assembly for the Nexa protocol
+#include "frame_decoder.h"
+// Duplicate suppression
+#include "dedup.h"
+// Voting over the repeats of a burst
+#include "soft_decoder.h"
+// Pulse counters of several receivers at once
+#include "bitslice.h"
+
+// Cross-repeat voting: frames with bad symbols still vote with their good ones and the repeats of a burst fill in
+// each other's gaps (see soft_decoder.h). The host tools override this to compare both.
+#ifndef SOFT_DECODE
+#define SOFT_DECODE 1
+#endif
+
+// Decoder context: all state needed to decode one sample stream, streams with their own context decode independently
+typedef struct {
+  pulse_detector_t detector;   // Pulse detection state
+  frame_decoder<nexa_protocol> frame;  // Frame assembly
+#if SOFT_DECODE
+  soft_decoder<nexa_protocol> soft;    // Voting over the repeats, for the packets no single frame delivers
+  uint32_t now;                // Time in samples
+#endif
+  uint32_t packet;             // Last packet, clean or voted
+  dedup_t dedup;               // Packets received lately, their repeats are dropped
+#ifndef ARDUINO
+  uint64_t clock_us;           // Time of the decoded signal: the host decodes recordings, not in real time
+#endif
+} nexa_decoder_t;
+
+// Receivers on one port at most
+#define PORT_RECEIVERS 8
+
+// Decoder context for up to 8 receivers sampled with one read of their port (RX_MULTI in sampler.h). The pulse
+// lengths of all receivers are counted in parallel in bit planes (see bitslice.h); each receiver only runs its own
+// pulse detector and frame decoder at its edges, and when its pulse reaches the length of a PAUSE. All receivers
+// share one duplicate suppression, so a packet heard by several of them comes out once. Frames are decoded without
+// voting: the receivers fill in for each other's lost frames instead.
+typedef struct {
+  uint8_t level;               // Levels of the latest sample, receiver i in bit i
+  uint8_t run[BITSLICE_BITS];  // Length of the current pulse of every receiver, in bit planes
+  uint8_t stopped;             // Receivers whose pulse was reported already (long enough for a PAUSE) or not connected
+  pulse_detector_t detector[PORT_RECEIVERS];
+  frame_decoder<nexa_protocol> frame[PORT_RECEIVERS];
+  dedup_t dedup;               // Packets received lately by any receiver
+#ifndef ARDUINO
+  uint64_t clock_us;           // Time of the decoded signal
+#endif
+} nexa_port_decoder_t;
+
+// Repeat interval in which identical packets are ignored after first reception: each bit consists of 3 short and 1 long pulse, 32 bits, plus start and sync, repeated 5 to 6 times.
+#define SAMPLES_PER_BIT        ( SHORT_HIGH_PULSE_SAMPLES * 2 + SHORT_LOW_PULSE_SAMPLES + LONG_PULSE_SAMPLES )
+#define REAL_PAUSE_SAMPLES     (END_PULSE_SAMPLES * 5)  // The real pause is longer but to save time its defined 5 times too small
+#define NUM_REPEATS            6
+#define REPEAT_IGNORE_SAMPLES  (((SAMPLES_PER_BIT * nexa_protocol::bits) + START_PULSE_SAMPLES + REAL_PAUSE_SAMPLES) * NUM_REPEATS)
+#define REPEAT_IGNORE_MS       ((uint32_t)REPEAT_IGNORE_SAMPLES * RX_SAMPLE_INTERVAL_US / 1000)
+
+static_assert(sizeof(nexa_protocol::word_t) == sizeof(dedup_entry_t::raw), "The duplicate suppression must hold a whole packet");
+
+/**
+ * Reset the decoder state, including the debouncer
+ */
+static inline void decoder_init(nexa_decoder_t *d) {
+  detector_init(&d->detector);
+  d->frame.init();
+#if SOFT_DECODE
+  d->soft.init();
+  d->now = 0;
+#endif
+  d->packet = 0;
+  dedup_init(&d->dedup);
+#ifndef ARDUINO
+  d->clock_us = 0;
+#endif
+}
+
+/**
+ * Raw value of the last packet returned by decodeSample(), cast to nexa_pckt_t to decode the fields
+ */
+static inline uint32_t lastPacket(const nexa_decoder_t *d) {
+  return d->packet;
+}
+
+/**
+ * Frame assembly: the frame decoder and, with SOFT_DECODE, the voting decoder on the same events
+ * @return 1 when a packet is complete, see packet
+ */
+static inline uint8_t assemble(nexa_decoder_t *d, uint8_t event) {
+  uint8_t res = d->frame.push(event);
+  if(res) d->packet = d->frame.word;
+#if SOFT_DECODE
+  // Most samples are inside a pulse and produce no event at all. A voted packet is one the frame decoder missed.
+  if(event != EVENT_NONE && d->soft.push(event, d->now, res)) {
+    d->packet = d->soft.result;
+    res = 1;
+  }
+#endif
+  return res;
+}
+
+/**
+ * Debouncer: drop packets received before within REPEAT_IGNORE_MS. The time is only needed when a packet arrives:
+ * the board clock, on the host the time of the decoded signal.
+ * @param res result of the frame decoder
+ * @return 1 when a new packet was received
+ */
+static inline uint8_t debounce(nexa_decoder_t *d, uint8_t res) {
+  if(!res) return 0;
+
+#ifdef ARDUINO
+  uint32_t now = millis();
+#else
+  uint32_t now = d->clock_us / 1000;
+#endif
+  return dedup_check(&d->dedup, d->packet, now, REPEAT_IGNORE_MS);
+}
+
+/**
+ * Push a sample through the decoder and the debouncer
+ * @return 1 when a new packet was received, see lastPacket()
+ */
+static inline uint8_t decodeSample(nexa_decoder_t *d, uint8_t sample) {
+#ifndef ARDUINO
+  d->clock_us += RX_SAMPLE_INTERVAL_US;
+#endif
+#if SOFT_DECODE
+  d->now++;
+#endif
+  return debounce(d, assemble(d, detectPulse(&d->detector, sample)));
+}
+
+/**
+ * Push a completed pulse (as timed by the input capture) through the decoder and the debouncer
+ * @return 1 when a new packet was received, see lastPacket()
+ */
+static inline uint8_t decodeEdge(nexa_decoder_t *d, uint8_t level, uint16_t duration_us) {
+#if SOFT_DECODE
+  d->now += (duration_us + RX_SAMPLE_INTERVAL_US / 2) / RX_SAMPLE_INTERVAL_US;
+#endif
+  uint8_t res = assemble(d, detectEdge(&d->detector, level, duration_us));
+  // A very long low pulse also drops a partial frame, like detectPulse() does once the zero counter stops
+  if(!level && duration_us > MAX_ZEROES * RX_SAMPLE_INTERVAL_US) d->frame.push(EVENT_INVALID);
+#ifndef ARDUINO
+  d->clock_us += duration_us;
+#endif
+  return debounce(d, res);
+}
+
+/**
+ * Push a completed pulse, given as a run of samples of the same level, through the decoder and the debouncer
+ * @return 1 when a new packet was received, see lastPacket()
+ */
+static inline uint8_t decodeRun(nexa_decoder_t *d, uint8_t level, uint32_t samples) {
+#if SOFT_DECODE
+  d->now += samples;
+#endif
+  uint8_t res = assemble(d, detectRun(&d->detector, level, samples));
+  // A very long low pulse also drops a partial frame, like detectPulse() does once the zero counter stops
+  if(!level && samples > MAX_ZEROES) d->frame.push(EVENT_INVALID);
+#ifndef ARDUINO
+  d->clock_us += (uint64_t)samples * RX_SAMPLE_INTERVAL_US;
+#endif
+  return debounce(d, res);
+}
+
+static_assert(END_PULSE_SAMPLES < (1 << BITSLICE_BITS), "Sample interval too short: pulses do not fit the bit planes");
+
+/**
+ * Reset the receiver port decoder
+ * @param mask the receivers connected, receiver i in bit i; the other bits of the port must read 0
+ */
+static inline void port_decoder_init(nexa_port_decoder_t *d, uint8_t mask) {
+  d->level = 0;
+  bitslice_clear(d->run, 0xFF);
+  // Receivers which are not connected never count
+  d->stopped = ~mask;
+  for(uint8_t i = 0; i < PORT_RECEIVERS; i++) {
+    detector_init(&d->detector[i]);
+    d->frame[i].init();
+  }
+  dedup_init(&d->dedup);
+#ifndef ARDUINO
+  d->clock_us = 0;
+#endif
+}
+
+/**
+ * Raw value of the packet a receiver returned from the last call to decodePort()
+ */
+static inline uint32_t portPacket(const nexa_port_decoder_t *d, uint8_t receiver) {
+  return d->frame[receiver].word;
+}
+
+/**
+ * Frame assembly and the shared debouncer for an event of one receiver
+ * @return 1 when the receiver received a new packet
+ */
+static inline uint8_t portEvent(nexa_port_decoder_t *d, uint8_t receiver, uint8_t event) {
+  if(event == EVENT_NONE || !d->frame[receiver].push(event)) return 0;
+
+#ifdef ARDUINO
+  uint32_t now = millis();
+#else
+  uint32_t now = d->clock_us / 1000;
+#endif
+  return dedup_check(&d->dedup, d->frame[receiver].word, now, REPEAT_IGNORE_MS);
+}
+
+/**
+ * Push one sample of all receivers through their decoders and the shared debouncer
+ * @param port the levels of the receivers, receiver i in bit i
+ * @return the receivers which received a new packet, see portPacket()
+ */
+static inline uint8_t decodePort(nexa_port_decoder_t *d, uint8_t port) {
+  uint8_t edges = port ^ d->level;
+  uint8_t fresh = 0;
+
+#ifndef ARDUINO
+  d->clock_us += RX_SAMPLE_INTERVAL_US;
+#endif
+
+  // Most samples are inside a pulse on every receiver; at an edge the pulse before it is complete
+  if(edges) {
+    // A pulse which reached a PAUSE was reported already
+    uint8_t pending = edges & ~d->stopped;
+    for(uint8_t i = 0; pending; i++, pending >>= 1) {
+      if(!(pending & 0x1)) continue;
+      uint8_t event = detectRun(&d->detector[i], (d->level >> i) & 0x1, bitslice_get(d->run, i));
+      if(portEvent(d, i, event)) fresh |= 1 << i;
+    }
+    bitslice_clear(d->run, edges);
+    d->stopped &= ~edges;
+    d->level = port;
+  }
+
+  // Count the sample on every receiver; a pulse as long as a PAUSE is reported right away and stops counting, a low
+  // one ends any frame (like detectPulse() does a few samples later), a high one is too long to be valid anyway
+  bitslice_count(d->run, ~d->stopped);
+  uint8_t ended = bitslice_equal(d->run, END_PULSE_SAMPLES) & ~d->stopped;
+  if(ended) {
+    d->stopped |= ended;
+    for(uint8_t i = 0; ended; i++, ended >>= 1) {
+      if(!(ended & 0x1)) continue;
+      uint8_t level = (port >> i) & 0x1;
+      if(portEvent(d, i, detectRun(&d->detector[i], level, END_PULSE_SAMPLES))) fresh |= 1 << i;
+      if(!level) d->frame[i].push(EVENT_INVALID);
+    }
+  }
+  return fresh;
+}
+
 /**
  * Standard decoder loop: read a sample, push it through the detection logic, wait
  */
@@ -0,0 +1,84 @@
+/**
+ * Duplicate suppression - drops the repeats of packets received within a time window
+ *
+ * A small cache of the packets seen lately. An entry lives until no frame of its packet arrived for the window, so
+ * a burst stretched by other remotes sending in between still counts as one. Expiry is only checked when a frame
+ * arrives, so nothing runs between packets. Several remotes pressed in alternation each keep their own entry, and
+ * every packet value (including 0) can be cached as entries have their own valid flag. When the cache is full,
+ * the entry heard from longest ago makes room.
+ *
+ * This is plain logic; the caller supplies the time so the host tools can run it on sample time.
+ */
+
+#ifndef _DEDUP_H_
+#define _DEDUP_H_
+
+#include <stdint.h>
+
+// Packets remembered at the same time
+#define DEDUP_ENTRIES 4
+
+typedef struct {
+  uint32_t raw;          // Packet
+  uint32_t time_ms;      // Time of the first frame
+  uint32_t last_ms;      // Time of the latest frame
+  uint8_t repeats;       // Frames received, including the first (saturates)
+  uint8_t used;          // Set while the entry holds a packet
+} dedup_entry_t;
+
+typedef struct {
+  dedup_entry_t entries[DEDUP_ENTRIES];
+  uint8_t last;          // Entry of the last frame checked
+} dedup_t;
+
+/**
+ * Forget all packets
+ */
+static inline void dedup_init(dedup_t *c) {
+  for(uint8_t i = 0; i < DEDUP_ENTRIES; i++) c->entries[i].used = 0;
+  c->last = 0;
+}
+
+/**
+ * Check a frame against the cache and remember it
+ * @return 1 when the packet was not seen within window_ms, 0 for a repeat
+ */
+static inline uint8_t dedup_check(dedup_t *c, uint32_t raw, uint32_t now_ms, uint32_t window_ms) {
+  uint8_t victim = 0;
+
+  for(uint8_t i = 0; i < DEDUP_ENTRIES; i++) {
+    dedup_entry_t *e = &c->entries[i];
+
+    // Expired entries are free again
+    if(e->used && now_ms - e->last_ms >= window_ms) e->used = 0;
+
+    if(e->used && e->raw == raw) {
+      if(e->repeats < 0xFF) e->repeats++;
+      e->last_ms = now_ms;
+      c->last = i;
+      return 0;
+    }
+
+    // Prefer a free entry, otherwise the one heard from longest ago
+    dedup_entry_t *v = &c->entries[victim];
+    if(v->used && (!e->used || now_ms - e->last_ms > now_ms - v->last_ms)) victim = i;
+  }
+
+  dedup_entry_t *e = &c->entries[victim];
+  e->raw = raw;
+  e->time_ms = now_ms;
+  e->last_ms = now_ms;
+  e->repeats = 1;
+  e->used = 1;
+  c->last = victim;
+  return 1;
+}
+
+/**
+ * Entry of the last frame checked
+ */
+static inline const dedup_entry_t *dedup_last(const dedup_t *c) {
+  return &c->entries[c->last];
+}
+
+#endif
@@ -0,0 +1,41 @@
+#include "devices.h"
+// Load the project config
+#include "config.h"
+
+// Only implement the functions when the dispatch is enabled
+#if ENABLE_DISPATCH && defined(ARDUINO)
+
+// Table lookup
+#include "dispatch.h"
+
+/**
+ * Example: switch the LED of the board; the on/off bit is 0 for on (see protocol.h)
+ */
+static void led(const nexa_pckt_t *p) {
+  digitalWrite(LED_BUILTIN, p->on_off ? LOW : HIGH);
+}
+
+// Remotes and their handlers, sorted by device id, then group, then unit. The unit is the raw code: Nexa sends
+// unit #1 as 3, Proove/Anslut as 0.
+static constexpr dispatch_entry_t devices[] PROGMEM = {
+  DISPATCH(0x12345A, 3, 0, led),     // Example remote, unit #1
+  DISPATCH(0x12345A, 3, 1, led),     // Example remote, group command
+};
+
+static_assert(dispatch_sorted(devices, sizeof(devices) / sizeof(devices[0])), "The device table must be sorted");
+
+/**
+ * Set up the pins the handlers use
+ */
+void devices_init() {
+  pinMode(LED_BUILTIN, OUTPUT);
+}
+
+/**
+ * Call the handlers registered for a new packet
+ */
+uint8_t devices_dispatch(uint32_t raw) {
+  return dispatch_packet(devices, sizeof(devices) / sizeof(devices[0]), raw);
+}
+
+#endif
@@ -0,0 +1,25 @@
+/**
+ * Device table - the remotes this board acts on and their handlers (ENABLE_DISPATCH in config.h)
+ *
+ * Edit devices.cpp for a deployment: write a handler per action and register it for the device id, unit and group
+ * of the remote in the table, sorted by device id (see dispatch.h). The full decoder passes every new packet here,
+ * repeats of a burst are dropped before.
+ */
+
+#ifndef _DEVICES_H_
+#define _DEVICES_H_
+
+#include <stdint.h>
+
+/**
+ * Set up the pins the handlers use
+ */
+void devices_init();
+
+/**
+ * Call the handlers registered for a new packet
+ * @return the number of handlers called
+ */
+uint8_t devices_dispatch(uint32_t raw);
+
+#endif
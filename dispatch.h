@@ -0,0 +1,95 @@
+/**
+ * Packet dispatch - passes new packets to the handlers registered for their remote, from a table in flash
+ *
+ * Every entry of the device table holds a key, made of the device id, unit and group of a packet, and the handler
+ * to call for it. The table is built at compile time and lives in program memory, so a registered remote costs no
+ * RAM, only 6 bytes of flash. It has to be sorted by key (dispatch_sorted() checks that at compile time), then a
+ * packet is found with a binary search: 8 steps for 256 remotes, 10 for 1024, where a linear scan reads the whole
+ * table for every packet that is not registered. Several handlers for the same key are called in table order.
+ * The on/off bit and the channel are not part of the key, the handler reads them from the packet.
+ *
+ * This is plain logic so the host tools can run it (host/dispatchbench.cpp); the table of the board is in
+ * devices.cpp.
+ */
+
+#ifndef _DISPATCH_H_
+#define _DISPATCH_H_
+
+#include <stdint.h>
+
+// Packet layout
+#include "protocols.h"
+
+#ifdef ARDUINO
+// Reads from the table in program memory, pgmspace comes with the core; a function pointer is a word on the AVR
+#define DISPATCH_READ_KEY(e)     pgm_read_dword(&(e)->key)
+#define DISPATCH_READ_HANDLER(e) ((dispatch_handler_t)(uintptr_t)pgm_read_word(&(e)->handler))
+#else
+// The host has no separate program memory
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define DISPATCH_READ_KEY(e)     ((e)->key)
+#define DISPATCH_READ_HANDLER(e) ((e)->handler)
+#endif
+
+// Key of a remote: device id, group and unit, in the order of the packet so sorting by key sorts by device id
+#define DISPATCH_KEY(device, unit, group) (((uint32_t)(device) << 3) | ((uint32_t)(group) << 2) | (unit))
+
+// Table entry calling handler for the packets of a remote
+#define DISPATCH(device, unit, group, handler) { DISPATCH_KEY(device, unit, group), handler }
+
+// Handler of a packet: runs in the sample loop between two samples, so keep it short (set a flag, switch a pin)
+typedef void (*dispatch_handler_t)(const nexa_pckt_t *p);
+
+typedef struct {
+  uint32_t key;
+  dispatch_handler_t handler;
+} dispatch_entry_t;
+
+/**
+ * Check at compile time that a table is sorted by key:
+ *   static_assert(dispatch_sorted(table, sizeof(table) / sizeof(table[0])), "...");
+ */
+static constexpr uint8_t dispatch_sorted(const dispatch_entry_t *table, uint16_t n) {
+  return n < 2 || (table[0].key <= table[1].key && dispatch_sorted(table + 1, n - 1));
+}
+
+/**
+ * Key of a raw packet
+ */
+static inline uint32_t dispatch_key(uint32_t raw) {
+  return DISPATCH_KEY(nexa_protocol::device(raw), nexa_protocol::unit(raw), nexa_protocol::group(raw));
+}
+
+/**
+ * Binary search for the first entry of a key
+ * @return its index, or the index where it would go when the key is not in the table
+ */
+static inline uint16_t dispatch_find(const dispatch_entry_t *table, uint16_t n, uint32_t key) {
+  uint16_t lo = 0, hi = n;
+
+  while(lo < hi) {
+    uint16_t mid = (lo + hi) >> 1;
+    if(DISPATCH_READ_KEY(&table[mid]) < key) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * Call the handlers registered for a packet
+ * @return the number of handlers called
+ */
+static inline uint8_t dispatch_packet(const dispatch_entry_t *table, uint16_t n, uint32_t raw) {
+  uint32_t key = dispatch_key(raw);
+  uint8_t calls = 0;
+
+  for(uint16_t i = dispatch_find(table, n, key); i < n && DISPATCH_READ_KEY(&table[i]) == key; i++) {
+    DISPATCH_READ_HANDLER(&table[i])((const nexa_pckt_t *)&raw);
+    calls++;
+  }
+  return calls;
+}
+
+#endif
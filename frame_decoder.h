@@ -0,0 +1,172 @@
+/**
+ * Frame decoder - assembles the pulse events into frames, specialized at compile time for a protocol descriptor
+ *
+ * Every frame starts with a SYNC and ends with a PAUSE, in between every 4 events (short high, low, short high, low)
+ * make up a symbol whose value comes from the descriptor (see protocols.h). Several frame decoders can listen to the
+ * same event stream: decoder_set expands to one call per protocol, without any indirection in the hot path.
+ */
+
+#ifndef _FRAME_DECODER_H_
+#define _FRAME_DECODER_H_
+
+#include <stdint.h>
+
+// Event codes and the pulse detector
+#include "decoder.h"
+// Protocol descriptors
+#include "protocols.h"
+
+template<typename P>
+struct frame_decoder {
+  typename P::word_t word;     // Data buffer, holds the last frame once it is complete
+  uint8_t eventbuf[4];         // Event buffer - each symbol consists of 4 pulse events
+  uint8_t ep;                  // Event pointer, set to the location of the next event insertion point
+  uint8_t seqval;              // Event sequence valid, set to 0 when unexpected sequences are detected
+  uint8_t nbits;               // Number of symbols in the data buffer
+
+  /**
+   * Reset the decoder state
+   */
+  void init() {
+    word = 0;
+    invalidate();
+  }
+
+  /**
+   * Invalidate the current frame (if any)
+   */
+  void invalidate() {
+    ep = 0;      // when invalid pulses or sequences of pulses are detected, reset the event pointer
+    seqval = 0;  // mark the whole sequence invalid
+    nbits = 0;   // Set the data buffer to begin over
+  }
+
+  /**
+   * Process one event from the pulse detector
+   * @return 1 when a frame of this protocol is complete, see word
+   */
+  uint8_t push(uint8_t event) {
+    // Boot mode: find the start of a frame
+    if(seqval == 0) {
+      // Sync pulse found - start of a new frame
+      if(event == EVENT_SYNC) seqval = 1;
+      return 0;
+    }
+
+    // Decoding mode: decoding a frame
+    switch(event) {
+      case EVENT_NONE:
+        // Inter-event samples, ignore
+        return 0;
+      case EVENT_HIGH_SHORT:
+      case EVENT_LOW_SHORT:
+      case EVENT_LOW_LONG:
+        // Normal events during a frame - add to event buffer
+        eventbuf[ep++] = event;
+        break;
+      case EVENT_SYNC:
+        // New sync detected, start over as this might be the start of a correct frame
+        invalidate();
+        seqval = 1;
+        return 0;
+      case EVENT_PAUSE:
+        // Marks the completion of the frame - this event is used down below
+        break;
+      case EVENT_INVALID:
+        invalidate();
+        return 0;
+    }
+
+    // When the event buffer is full, see if a valid symbol was received
+    if(ep == 4) {
+      uint8_t value = SYMBOL_INVALID;
+      ep = 0;
+
+      if(eventbuf[0] == EVENT_HIGH_SHORT && eventbuf[1] != EVENT_HIGH_SHORT &&
+         eventbuf[2] == EVENT_HIGH_SHORT && eventbuf[3] != EVENT_HIGH_SHORT) {
+        value = P::symbol(((eventbuf[1] == EVENT_LOW_LONG) << 1) | (eventbuf[3] == EVENT_LOW_LONG), nbits);
+      }
+
+      // Anything else is an error and invalidates the whole reception, as does a frame which is too long
+      if(value == SYMBOL_INVALID || nbits == P::bits) {
+        invalidate();
+        return 0;
+      }
+      word = (word << 1) | value;
+      nbits++;
+    }
+
+    // See if we detected a PAUSE which should complete the frame
+    if(event == EVENT_PAUSE && nbits == P::bits) {
+      // Invalidate the decoder state so a new frame can be received
+      invalidate();
+      return P::accept(word);
+    }
+
+    return 0;
+  }
+};
+
+/**
+ * A set of frame decoders fed from one event stream, the first protocol in bit 0 of the result
+ */
+template<typename... Ps>
+struct decoder_set;
+
+template<>
+struct decoder_set<> {
+  void init() {}
+  uint8_t push(uint8_t) { return 0; }
+};
+
+template<typename P, typename... Ps>
+struct decoder_set<P, Ps...> {
+  // The pulse detector classifies with the widths from protocol.h, so it can only serve protocols which use those
+  static_assert(P::high_us == RX_SHORT_HIGH_US && P::short_us == RX_SHORT_LOW_US &&
+                P::long_us == RX_LONG_LOW_US && P::sync_us == RX_START_LOW_US,
+                "Protocols with other pulse widths need a pulse detector of their own");
+  static_assert(sizeof...(Ps) < 8, "At most 8 protocols per set");
+
+  frame_decoder<P> frame;      // Decoder for this protocol
+  decoder_set<Ps...> rest;     // Decoders for the other protocols
+
+  void init() {
+    frame.init();
+    rest.init();
+  }
+
+  /**
+   * Process one event in all decoders
+   * @return bit i set when a frame of protocol i is complete
+   */
+  uint8_t push(uint8_t event) {
+    return frame.push(event) | (rest.push(event) << 1);
+  }
+};
+
+/**
+ * Pulse detector and a set of frame decoders: one pass over the samples decodes all protocols
+ */
+template<typename... Ps>
+struct multi_decoder {
+  pulse_detector_t detector;
+  decoder_set<Ps...> set;
+
+  void init() {
+    detector_init(&detector);
+    set.init();
+  }
+
+  /**
+   * Push a sample through the pulse detector and all frame decoders
+   * @return bit i set when a frame of protocol i is complete
+   */
+  uint8_t sample(uint8_t val) {
+    uint8_t event = detectPulse(&detector, val);
+    // Most samples are inside a pulse and produce no event at all
+    if(event == EVENT_NONE) return 0;
+    return set.push(event);
+  }
+};
+
+#endif
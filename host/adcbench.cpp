@@ -0,0 +1,286 @@
+/**
+ * ADC front end benchmark - decode yield and cost of the analog front ends on synthesized and recorded ADC traces
+ *
+ * Every scenario synthesizes bursts of repeated frames as the readings of the free-running ADC, one every
+ * OVERSAMPLE_CONVERSION_US, with the analog channel model of synth.h (noise on every reading and spikes to random
+ * values), and turns them into samples with each front end:
+ *   single  the slicer on the latest reading of each sample, as without RX_OVERSAMPLE
+ *   sum     the moving sum of the latest readings, sliced (oversample.h)
+ *   vote    the majority of the latest readings against the slicer threshold (oversample.h)
+ * The samples go through the full decoder. Only the front end is timed, per reading, as it runs in the interrupt.
+ *
+ * With a file it reads a recorded trace instead: one reading per byte (the top 8 bits of the conversion, as replay -A
+ * reads them), -i us apart, and reports the packets each front end finds.
+ *
+ * One line per scenario and front end with key=value pairs:
+ *   yield     packets decoded / packets sent
+ *   false     packets which were not sent in the burst they were found in, and their rate per 1000 bursts
+ *
+ * Usage: adcbench [-b bursts] [-r repeats] [-S scenario] [-s seed] [-F]
+ *        adcbench [-i us] [-F] trace
+ *   -F  fixed slicer thresholds instead of the adaptive ones
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../config.h"
+#include "../decoder_full.h"
+#include "../oversample.h"
+#include "synth.h"
+
+// Silence between bursts, in us - long enough for the debouncer to forget the previous packet
+#define BURST_GAP_US 300000
+
+// Bursts synthesized and decoded at a time
+#define CHUNK_BURSTS 64
+
+// Front ends
+#define FRONT_SINGLE 0
+#define FRONT_SUM    1
+#define FRONT_VOTE   2
+#define FRONT_ENDS   3
+
+static const char *front_names[FRONT_ENDS] = { "single", "sum", "vote" };
+
+typedef struct {
+  const char *name;
+  long jitter_us;           // Edge jitter
+  synth_analog_t analog;    // Levels, noise and spikes of the readings
+} scenario_t;
+
+// The fixed thresholds of sampler.h sit between the low and the high level
+static const scenario_t scenarios[] = {
+  { "clean",  25, { 8, 36, 0,  0     } },
+  { "noise",  25, { 8, 36, 24, 0     } },
+  { "spikes", 25, { 8, 36, 0,  2000  } },
+  { "weak",   25, { 8, 28, 6,  1000  } },
+  { "mixed",  50, { 8, 36, 10, 2000  } },
+};
+#define SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+// State of a front end and the decoder behind it, kept from chunk to chunk
+typedef struct {
+  oversampler_t o;
+  slicer_t slicer;
+  nexa_decoder_t decoder;
+  uint64_t slot_us;         // End of the next sample, counted from the first reading of the chunk
+} front_t;
+
+static int adaptive = 1;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void frontInit(front_t *f) {
+  oversample_init(&f->o, RX_ANALOG_LEVEL_HIGH, RX_ANALOG_LEVEL_LOW);
+  slicer_init(&f->slicer, RX_ANALOG_LEVEL_HIGH, RX_ANALOG_LEVEL_LOW);
+  decoder_init(&f->decoder);
+  f->slot_us = RX_SAMPLE_INTERVAL_US;
+}
+
+/**
+ * Turn the readings into samples: before each sample the readings converted up to its time are pushed, as the
+ * interrupt does between two samples of the sample loop
+ * @return the number of samples
+ */
+template<int F>
+static unsigned long sampleReadings(front_t *f, const uint8_t *readings, unsigned long n, uint32_t reading_us,
+                                    uint8_t *out) {
+  unsigned long i = 0, k = 0;
+  uint64_t done_us = reading_us;   // Time the next reading is complete
+
+  while(1) {
+    while(i < n && done_us <= f->slot_us) {
+      if(F == FRONT_SINGLE) f->o.readings[0] = readings[i];
+      if(F == FRONT_SUM) oversample_sum_push(&f->o, readings[i]);
+      if(F == FRONT_VOTE) oversample_vote_push(&f->o, readings[i]);
+      i++;
+      done_us += reading_us;
+    }
+    if(i == n) break;
+
+    if(F == FRONT_SINGLE) {
+      uint16_t val = (uint16_t)f->o.readings[0] << 2;
+      out[k++] = adaptive ? slicer_adapt(&f->slicer, val) : slicer_step(&f->slicer, val);
+    }
+    if(F == FRONT_SUM) out[k++] = oversample_sum_sample(&f->o, f->o.sum, adaptive);
+    if(F == FRONT_VOTE) out[k++] = oversample_vote_sample(&f->o, f->o.votes, adaptive);
+    f->slot_us += RX_SAMPLE_INTERVAL_US;
+  }
+
+  // The next chunk counts from its first reading
+  f->slot_us -= done_us - reading_us;
+  return k;
+}
+
+static unsigned long frontEnd(int fe, front_t *f, const uint8_t *readings, unsigned long n, uint32_t reading_us,
+                              uint8_t *out) {
+  switch(fe) {
+    case FRONT_SUM:  return sampleReadings<FRONT_SUM>(f, readings, n, reading_us, out);
+    case FRONT_VOTE: return sampleReadings<FRONT_VOTE>(f, readings, n, reading_us, out);
+  }
+  return sampleReadings<FRONT_SINGLE>(f, readings, n, reading_us, out);
+}
+
+static void run(const scenario_t *sc, int bursts, int repeats, uint32_t seed) {
+  synth_signal_t sig = { NULL, 0, 0 };
+  uint32_t sent[CHUNK_BURSTS];
+  uint8_t found[CHUNK_BURSTS];
+  unsigned long start[CHUNK_BURSTS + 1];
+  uint8_t *samples = NULL;
+  unsigned long good[FRONT_ENDS] = { 0 }, bad[FRONT_ENDS] = { 0 }, nsamples = 0, readings = 0;
+  double t[FRONT_ENDS] = { 0 };
+  front_t front[FRONT_ENDS];
+  uint32_t rng = seed;
+
+  for(int fe = 0; fe < FRONT_ENDS; fe++) frontInit(&front[fe]);
+
+  for(int done = 0; done < bursts; done += CHUNK_BURSTS) {
+    int n = MIN(CHUNK_BURSTS, bursts - done);
+    sig.count = 0;
+
+    for(int b = 0; b < n; b++) {
+      synth_train_t train = { NULL, 0, 0 };
+      start[b] = sig.count;
+      sent[b] = synth_rand(&rng);
+      for(int r = 0; r < repeats; r++) synth_frame(&train, sent[b], 0);
+      synth_pulse(&train, 0, BURST_GAP_US);
+      synth_sample(&sig, &train, OVERSAMPLE_CONVERSION_US, sc->jitter_us, &rng);
+      free(train.pulses);
+    }
+    start[n] = sig.count;
+    synth_analog(&sig, 0, &sc->analog, &rng);
+    samples = (uint8_t *)realloc(samples, sig.count * OVERSAMPLE_CONVERSION_US / RX_SAMPLE_INTERVAL_US + 1);
+
+    for(int fe = 0; fe < FRONT_ENDS; fe++) {
+      double t0 = now();
+      unsigned long k = frontEnd(fe, &front[fe], sig.samples, sig.count, OVERSAMPLE_CONVERSION_US, samples);
+      t[fe] += now() - t0;
+      if(!fe) nsamples += k;
+
+      // Decode, checking each packet against the burst it was found in
+      memset(found, 0, sizeof(found));
+      int b = 0;
+      for(unsigned long i = 0; i < k; i++) {
+        if(!decodeSample(&front[fe].decoder, samples[i])) continue;
+        unsigned long at = (i + 1) * RX_SAMPLE_INTERVAL_US / OVERSAMPLE_CONVERSION_US;
+        while(b < n && at >= start[b + 1]) b++;
+        if(b == n || lastPacket(&front[fe].decoder) != sent[b]) bad[fe]++;
+        else if(!found[b]) {
+          found[b] = 1;
+          good[fe]++;
+        }
+      }
+    }
+    readings += sig.count;
+  }
+
+  for(int fe = 0; fe < FRONT_ENDS; fe++) {
+    printf("scenario=%s front=%s slicer=%s interval_us=%d conversion_us=%d bursts=%d repeats=%d jitter_us=%ld low=%u "
+           "high=%u noise=%u spike_ppm=%u packets=%d decoded=%lu yield=%.3f%% false=%lu false_per_1000=%.3f "
+           "readings=%lu samples=%lu ns/reading=%.2f\n",
+           sc->name, front_names[fe], adaptive ? "adaptive" : "fixed", RX_SAMPLE_INTERVAL_US, OVERSAMPLE_CONVERSION_US,
+           bursts, repeats, sc->jitter_us, sc->analog.low, sc->analog.high, sc->analog.noise, sc->analog.spike_ppm,
+           bursts, good[fe], 100.0 * good[fe] / bursts, bad[fe], 1000.0 * bad[fe] / bursts, readings, nsamples,
+           t[fe] * 1e9 / readings);
+  }
+  fflush(stdout);
+
+  free(sig.samples);
+  free(samples);
+}
+
+/**
+ * Run the front ends over a recorded trace
+ */
+static int trace(const char *name, uint32_t reading_us) {
+  FILE *f = fopen(name, "rb");
+  if(!f) {
+    perror(name);
+    return 1;
+  }
+
+  uint8_t *readings = NULL;
+  unsigned long n = 0, cap = 0;
+  size_t got;
+  do {
+    if(n == cap) {
+      cap = cap ? cap * 2 : 65536;
+      readings = (uint8_t *)realloc(readings, cap);
+    }
+    got = fread(readings + n, 1, cap - n, f);
+    n += got;
+  } while(got);
+  fclose(f);
+
+  uint8_t *samples = (uint8_t *)malloc(n * reading_us / RX_SAMPLE_INTERVAL_US + 1);
+  for(int fe = 0; fe < FRONT_ENDS; fe++) {
+    front_t front;
+    unsigned long packets = 0;
+
+    frontInit(&front);
+    double t0 = now();
+    unsigned long k = frontEnd(fe, &front, readings, n, reading_us, samples);
+    double t = now() - t0;
+    for(unsigned long i = 0; i < k; i++) packets += decodeSample(&front.decoder, samples[i]);
+
+    printf("trace=%s front=%s slicer=%s interval_us=%d reading_us=%u readings=%lu samples=%lu packets=%lu "
+           "ns/reading=%.2f\n", name, front_names[fe], adaptive ? "adaptive" : "fixed", RX_SAMPLE_INTERVAL_US,
+           reading_us, n, k, packets, t * 1e9 / n);
+  }
+
+  free(readings);
+  free(samples);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int bursts = 2000, repeats = 5, opt;
+  uint32_t reading_us = OVERSAMPLE_CONVERSION_US;
+  const char *only = NULL;
+  uint32_t rng = 12345;
+
+  while((opt = getopt(argc, argv, "b:r:S:s:i:F")) != -1) {
+    switch(opt) {
+      case 'b': bursts = atoi(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      case 'S': only = optarg; break;
+      case 's': rng = strtoul(optarg, NULL, 0) | 1; break;
+      case 'i': reading_us = atoi(optarg); break;
+      case 'F': adaptive = 0; break;
+      default:
+        fprintf(stderr, "Usage: %s [-b bursts] [-r repeats] [-S scenario] [-s seed] [-F]\n"
+                        "       %s [-i us] [-F] trace\n", argv[0], argv[0]);
+        return 2;
+    }
+  }
+
+  if(optind < argc) {
+    if(!reading_us) {
+      fprintf(stderr, "The readings need a time\n");
+      return 2;
+    }
+    return trace(argv[optind], reading_us);
+  }
+
+  int found = 0;
+  for(unsigned i = 0; i < SCENARIOS; i++) {
+    if(only && strcmp(only, scenarios[i].name)) continue;
+    // Every scenario starts from the same seed so a change in one does not move the others
+    run(&scenarios[i], bursts, repeats, rng);
+    found = 1;
+  }
+
+  if(!found) {
+    fprintf(stderr, "Unknown scenario %s\n", only);
+    return 2;
+  }
+  return 0;
+}
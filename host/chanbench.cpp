@@ -0,0 +1,190 @@
+/**
+ * Channel benchmark - decode yield, false packets and cost of the full decoder over a simulated RF channel
+ *
+ * Every scenario synthesizes bursts of repeated frames with random packets and passes them through the channel
+ * model of synth.h (edge jitter, clock skew, a weak signal, bit flips, noise bursts, noise in the long lows of a
+ * receiver with gain control and a second transmitter keyed during the burst), then decodes them with decodeSample().
+ * In the interleave scenario several transmitters take turns frame by frame, as remotes pressed in alternation do;
+ * each packet must come out exactly once. The signal is synthesized and decoded in chunks so millions of frames fit
+ * in memory; only the decoding is timed.
+ *
+ * One line per scenario with key=value pairs, to compare the output of different versions:
+ *   yield     packets decoded / packets sent (an overlapping burst sends two)
+ *   false     packets which were not sent in the burst they were found in, and their rate per 1000 bursts
+ *   dups      packets which came out more than once in a burst
+ *
+ * Usage: chanbench [-b bursts] [-r repeats] [-S scenario] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../config.h"
+#include "../decoder_full.h"
+#include "synth.h"
+
+// Silence between bursts, in us - long enough for the debouncer to forget the previous packet
+#define BURST_GAP_US 300000
+
+// Bursts synthesized and decoded at a time
+#define CHUNK_BURSTS 256
+
+// Packets in a burst at most
+#define BURST_PACKETS 4
+
+typedef struct {
+  const char *name;
+  long jitter_us;           // Edge jitter
+  int skew;                 // Clock error of each transmitter, random up to this percentage
+  uint32_t weak_us;         // High pulses shortened by the receiver
+  synth_channel_t channel;  // Bit flips and noise bursts
+  int overlap;              // 1: a second transmitter starts at a random point of every burst
+  int interleave;           // Transmitters taking turns frame by frame in every burst
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+  { "clean",      0,  0,  0,  { 0,    0,  0,    0     }, 0, 1 },
+  { "jitter",     50, 0,  0,  { 0,    0,  0,    0     }, 0, 1 },
+  { "skew",       25, 15, 0,  { 0,    0,  0,    0     }, 0, 1 },
+  { "weak",       25, 0,  50, { 0,    0,  0,    0     }, 0, 1 },
+  { "flips",      25, 0,  0,  { 1000, 0,  0,    0     }, 0, 1 },
+  { "noise",      25, 0,  0,  { 0,    20, 2000, 0     }, 0, 1 },
+  { "agc",        25, 0,  0,  { 0,    0,  0,    20000 }, 0, 1 },
+  { "overlap",    25, 0,  0,  { 0,    0,  0,    0     }, 1, 1 },
+  { "interleave", 25, 0,  0,  { 0,    0,  0,    0     }, 0, 3 },
+  { "mixed",      50, 10, 25, { 500,  10, 2000, 0     }, 1, 1 },
+};
+#define SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Synthesize the samples of n transmitters taking turns, each sending its packet repeats times
+ */
+static void transmit(synth_signal_t *s, const scenario_t *sc, const uint32_t *raw, int n, int repeats, uint32_t *rng) {
+  synth_train_t train = { NULL, 0, 0 };
+  int k[BURST_PACKETS];
+
+  for(int i = 0; i < n; i++) k[i] = synth_jitter(rng, sc->skew);
+  for(int r = 0; r < repeats; r++) {
+    for(int i = 0; i < n; i++) synth_frame(&train, raw[i], k[i]);
+  }
+  if(sc->weak_us) synth_attenuate(&train, sc->weak_us);
+  synth_sample(s, &train, RX_SAMPLE_INTERVAL_US, sc->jitter_us, rng);
+  free(train.pulses);
+}
+
+static void run(const scenario_t *sc, int bursts, int repeats, uint32_t rng) {
+  synth_signal_t sig = { NULL, 0, 0 }, other = { NULL, 0, 0 };
+  uint32_t sent[CHUNK_BURSTS][BURST_PACKETS];
+  uint8_t nsent[CHUNK_BURSTS], found[CHUNK_BURSTS];
+  unsigned long start[CHUNK_BURSTS + 1];
+  unsigned long packets = 0, good = 0, bad = 0, dups = 0, samples = 0;
+  nexa_decoder_t decoder;
+  double t = 0;
+
+  decoder_init(&decoder);
+
+  for(int done = 0; done < bursts; done += CHUNK_BURSTS) {
+    int n = MIN(CHUNK_BURSTS, bursts - done);
+    sig.count = 0;
+
+    for(int b = 0; b < n; b++) {
+      start[b] = sig.count;
+      found[b] = 0;
+      nsent[b] = sc->interleave;
+      for(int i = 0; i < nsent[b]; i++) sent[b][i] = synth_rand(&rng);
+      transmit(&sig, sc, sent[b], nsent[b], repeats, &rng);
+
+      // The second transmitter starts anywhere in the first one's burst
+      if(sc->overlap) {
+        sent[b][nsent[b]] = synth_rand(&rng);
+        other.count = 0;
+        transmit(&other, sc, &sent[b][nsent[b]], 1, repeats, &rng);
+        synth_mix(&sig, start[b] + synth_rand(&rng) % (sig.count - start[b]), &other);
+        nsent[b]++;
+      }
+      packets += nsent[b];
+
+      // Silence up to the next burst
+      synth_train_t gap = { NULL, 0, 0 };
+      synth_pulse(&gap, 0, BURST_GAP_US);
+      synth_sample(&sig, &gap, RX_SAMPLE_INTERVAL_US, 0, &rng);
+      free(gap.pulses);
+    }
+    start[n] = sig.count;
+    synth_corrupt(&sig, 0, &sc->channel, &rng);
+
+    // Decode, checking each packet against the burst it was found in
+    int b = 0;
+    double t0 = now();
+    for(unsigned long i = 0; i < sig.count; i++) {
+      if(decodeSample(&decoder, sig.samples[i])) {
+        uint32_t raw = lastPacket(&decoder);
+        int p = 0;
+        while(i >= start[b + 1]) b++;
+        while(p < nsent[b] && raw != sent[b][p]) p++;
+        if(p == nsent[b]) bad++;
+        else if(found[b] & (1 << p)) dups++;
+        else {
+          found[b] |= 1 << p;
+          good++;
+        }
+      }
+    }
+    t += now() - t0;
+    samples += sig.count;
+  }
+
+  printf("scenario=%s interval_us=%d clock=%s sync=%s decode=%s bursts=%d repeats=%d frames=%lu jitter_us=%ld skew=%d weak_us=%u "
+         "flip_ppm=%u noise_per_s=%u noise_us=%u overlap=%d interleave=%d packets=%lu decoded=%lu yield=%.3f%% "
+         "false=%lu false_per_1000=%.3f dups=%lu samples=%lu ns/sample=%.2f\n",
+         sc->name, RX_SAMPLE_INTERVAL_US, CLOCK_RECOVERY ? "recovered" : "fixed", SYNC_CORRELATE ? "correlated" : "length",
+         SOFT_DECODE ? "soft" : "hard", bursts, repeats,
+         packets * repeats, sc->jitter_us, sc->skew, sc->weak_us,
+         sc->channel.flip_ppm, sc->channel.noise_per_s, sc->channel.noise_us, sc->overlap, sc->interleave,
+         packets, good, 100.0 * good / packets, bad, 1000.0 * bad / bursts, dups, samples, t * 1e9 / samples);
+  fflush(stdout);
+
+  free(sig.samples);
+  free(other.samples);
+}
+
+int main(int argc, char **argv) {
+  int bursts = 20000, repeats = 5, opt;
+  const char *only = NULL;
+  uint32_t rng = 12345;
+
+  while((opt = getopt(argc, argv, "b:r:S:s:")) != -1) {
+    switch(opt) {
+      case 'b': bursts = atoi(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      case 'S': only = optarg; break;
+      case 's': rng = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-b bursts] [-r repeats] [-S scenario] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  int found = 0;
+  for(unsigned i = 0; i < SCENARIOS; i++) {
+    if(only && strcmp(only, scenarios[i].name)) continue;
+    // Every scenario starts from the same seed so a change in one does not move the others
+    run(&scenarios[i], bursts, repeats, rng);
+    found = 1;
+  }
+
+  if(!found) {
+    fprintf(stderr, "Unknown scenario %s\n", only);
+    return 2;
+  }
+  return 0;
+}
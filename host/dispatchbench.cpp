@@ -0,0 +1,165 @@
+/**
+ * Dispatch benchmark - lookup cost of the device table (dispatch.h) against a linear scan, per table size
+ *
+ * For every table size it registers that many remotes with random device ids, units and groups, sorts the table as
+ * devices.cpp has to be, and dispatches a stream of packets of which a given share comes from a registered remote
+ * (with a random on/off bit and channel, which are not part of the key). The same packets go through a linear scan
+ * of the unsorted table which stops at the first match, like a chain of if statements on the device id does.
+ * Both must call the same number of handlers.
+ *
+ * One line per table size and path with key=value pairs:
+ *   calls       handlers called
+ *   ns/packet   time per packet, the handlers included
+ *
+ * Usage: dispatchbench [-p packets] [-h hit_percent] [-s seed] [remotes...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../dispatch.h"
+#include "synth.h"
+
+// Table sizes when none are given
+static const int default_sizes[] = { 4, 16, 64, 256, 1024 };
+
+static unsigned long calls = 0, on = 0;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void handler(const nexa_pckt_t *p) {
+  calls++;
+  on += p->on_off;
+}
+
+// The compile time check of the table order, on a table as devices.cpp writes it
+static constexpr dispatch_entry_t sorted_table[] = {
+  DISPATCH(0x00ABCD, 3, 0, handler),
+  DISPATCH(0x00ABCD, 3, 1, handler),
+  DISPATCH(0x123456, 0, 0, handler),
+  DISPATCH(0x123456, 1, 0, handler),
+};
+static constexpr dispatch_entry_t unsorted_table[] = {
+  DISPATCH(0x123456, 0, 0, handler),
+  DISPATCH(0x00ABCD, 3, 0, handler),
+};
+static_assert(dispatch_sorted(sorted_table, sizeof(sorted_table) / sizeof(sorted_table[0])), "Sorted table rejected");
+static_assert(!dispatch_sorted(unsorted_table, sizeof(unsorted_table) / sizeof(unsorted_table[0])),
+              "Unsorted table accepted");
+
+static int byKey(const void *a, const void *b) {
+  uint32_t x = ((const dispatch_entry_t *)a)->key, y = ((const dispatch_entry_t *)b)->key;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * A raw packet of a remote with a random on/off bit and channel
+ */
+static uint32_t packetOf(uint32_t key, uint32_t *rng) {
+  uint32_t device = key >> 3, group = (key >> 2) & 0x1, unit = key & 0x3, r = synth_rand(rng);
+  return (device << 6) | (group << 5) | ((r & 0x1) << 4) | (((r >> 1) & 0x3) << 2) | unit;
+}
+
+/**
+ * Linear scan, stops at the first match
+ */
+static uint8_t scan(const dispatch_entry_t *table, uint16_t n, uint32_t raw) {
+  uint32_t key = dispatch_key(raw);
+  for(uint16_t i = 0; i < n; i++) {
+    if(table[i].key == key) {
+      table[i].handler((const nexa_pckt_t *)&raw);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void run(int remotes, unsigned long packets, int hit_percent, uint32_t rng) {
+  dispatch_entry_t *unsorted = (dispatch_entry_t *)malloc(remotes * sizeof(dispatch_entry_t));
+  dispatch_entry_t *table = (dispatch_entry_t *)malloc(remotes * sizeof(dispatch_entry_t));
+  uint32_t *raw = (uint32_t *)malloc(packets * sizeof(uint32_t));
+
+  // Distinct remotes, so the scan which stops at the first match calls the same handlers
+  for(int i = 0; i < remotes; i++) {
+    uint32_t key;
+    int dup;
+    do {
+      key = synth_rand(&rng) & 0x1FFFFFFF;
+      dup = 0;
+      for(int j = 0; j < i && !dup; j++) dup = unsorted[j].key == key;
+    } while(dup);
+    unsorted[i].key = key;
+    unsorted[i].handler = handler;
+  }
+  memcpy(table, unsorted, remotes * sizeof(dispatch_entry_t));
+  qsort(table, remotes, sizeof(dispatch_entry_t), byKey);
+
+  // Random packets are practically never registered
+  for(unsigned long i = 0; i < packets; i++) {
+    if((int)(synth_rand(&rng) % 100) < hit_percent) raw[i] = packetOf(unsorted[synth_rand(&rng) % remotes].key, &rng);
+    else raw[i] = synth_rand(&rng);
+  }
+
+  const char *names[2] = { "linear", "binary" };
+  unsigned long found[2];
+  for(int p = 0; p < 2; p++) {
+    calls = 0;
+    double t0 = now();
+    if(p) {
+      for(unsigned long i = 0; i < packets; i++) dispatch_packet(table, remotes, raw[i]);
+    } else {
+      for(unsigned long i = 0; i < packets; i++) scan(unsorted, remotes, raw[i]);
+    }
+    double t = now() - t0;
+    found[p] = calls;
+    printf("remotes=%d path=%s packets=%lu hit_percent=%d calls=%lu avr_flash_bytes=%lu ns/packet=%.2f\n", remotes,
+           names[p], packets, hit_percent, calls, (unsigned long)remotes * 6, t * 1e9 / packets);
+  }
+  if(found[0] != found[1]) printf("MISMATCH remotes=%d linear=%lu binary=%lu\n", remotes, found[0], found[1]);
+  fflush(stdout);
+
+  free(unsorted);
+  free(table);
+  free(raw);
+}
+
+int main(int argc, char **argv) {
+  unsigned long packets = 1000000;
+  int hit_percent = 50, opt;
+  uint32_t rng = 12345;
+
+  while((opt = getopt(argc, argv, "p:h:s:")) != -1) {
+    switch(opt) {
+      case 'p': packets = strtoul(optarg, NULL, 0); break;
+      case 'h': hit_percent = atoi(optarg); break;
+      case 's': rng = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-p packets] [-h hit_percent] [-s seed] [remotes...]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  if(optind < argc) {
+    for(int i = optind; i < argc; i++) {
+      int remotes = atoi(argv[i]);
+      if(remotes < 1 || remotes > 65535) {
+        fprintf(stderr, "Between 1 and 65535 remotes\n");
+        return 2;
+      }
+      run(remotes, packets, hit_percent, rng);
+    }
+    return 0;
+  }
+
+  for(unsigned i = 0; i < sizeof(default_sizes) / sizeof(default_sizes[0]); i++) {
+    run(default_sizes[i], packets, hit_percent, rng);
+  }
+  return 0;
+}
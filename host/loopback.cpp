@@ -0,0 +1,146 @@
+/**
+ * Transmitter loopback - plays the pulse tables of the transmitter back into the decoder
+ *
+ * Random packets are turned into pulse tables with tx_frame_build() exactly as the transmitter does, and the edge
+ * timings the interrupt would generate are collected into a pulse train. The receiver is modeled by shortening
+ * every high pulse and stretching every low pulse by the same bias. Each burst is decoded sample by sample with
+ * decodeSample() and pulse by pulse with decodeEdge(); every burst must give its packet once, every frame must be
+ * found by the frame decoder. The sampled path goes through a receiver (receiver.h) which samples the pulse train
+ * itself (synth_source), from the same random state as the samples the frame decoder gets.
+ * Exits with 1 on any mismatch.
+ *
+ * Usage: loopback [-b bursts] [-r repeats] [-j jitter_us] [-d bias_us] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../receiver.h"
+#include "../transmitter.h"
+#include "synth.h"
+
+// Silence between bursts, in us
+#define BURST_GAP_US 300000
+
+// Result of one decoding path
+typedef struct {
+  unsigned long ok;        // Bursts decoded to the packet which was sent
+  unsigned long wrong;     // Packets which were not sent
+  unsigned long missed;    // Bursts without a packet
+  unsigned long frames;    // Frames found by the frame decoder (before the debouncer)
+} result_t;
+
+// Receiver sink counting the packets of a burst against the one which was sent
+struct burst_sink {
+  uint32_t sent;
+  unsigned long packets, wrong;
+
+  void packet(uint32_t raw, uint32_t) {
+    if(raw == sent) packets++;
+    else wrong++;
+  }
+  void repeats(const dedup_entry_t *) {}
+  void idle(uint16_t) {}
+};
+
+static void account(result_t *r, unsigned long packets, unsigned long wrong) {
+  if(packets == 0) r->missed++;
+  else r->ok++;
+  r->wrong += wrong + (packets > 1 ? packets - 1 : 0);
+}
+
+static void report(const char *path, const result_t *r, int bursts, int repeats) {
+  printf("%-8s ok=%lu wrong=%lu missed=%lu frames=%lu/%lu\n", path, r->ok, r->wrong, r->missed,
+         r->frames, (unsigned long)bursts * repeats);
+}
+
+int main(int argc, char **argv) {
+  int bursts = 1000, repeats = TX_REPEATS_NEXA, opt;
+  long jitter = 25, bias = SHORT_PULSE - RX_SHORT_HIGH_US;
+  uint32_t rng = 12345;
+
+  while((opt = getopt(argc, argv, "b:r:j:d:s:")) != -1) {
+    switch(opt) {
+      case 'b': bursts = atoi(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      case 'j': jitter = atol(optarg); break;
+      case 'd': bias = atol(optarg); break;
+      case 's': rng = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-b bursts] [-r repeats] [-j jitter_us] [-d bias_us] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  receiver<synth_source, burst_sink> rx;
+  nexa_decoder_t edges_dec;
+  multi_decoder<nexa_protocol> frames_dec;
+  pulse_detector_t edges_pd;
+  frame_decoder<nexa_protocol> edges_frame;
+  result_t rs = { 0, 0, 0, 0 }, re = { 0, 0, 0, 0 };
+  // One decoder for all bursts, the source starts again on every burst
+  decoder_init(&rx.decoder);
+  rx.source.interval_us = RX_SAMPLE_INTERVAL_US;
+  rx.source.jitter_us = jitter;
+  decoder_init(&edges_dec);
+  frames_dec.init();
+  detector_init(&edges_pd);
+  edges_frame.init();
+
+  for(int b = 0; b < bursts; b++) {
+    uint32_t raw = synth_rand(&rng);
+    tx_frame_t frame;
+    synth_train_t train = { NULL, 0, 0 };
+    synth_signal_t sig = { NULL, 0, 0 };
+    unsigned long packets = 0, wrong = 0;
+
+    // The edges the interrupt generates, as the receiver outputs them
+    tx_frame_build(&frame, raw);
+    for(int r = 0; r < repeats; r++) {
+      for(uint8_t n = 0; n < TX_PULSES; n++) {
+        long us = tx_pulse_us(&frame, n) + (TX_PULSE_LEVEL(n) ? -bias : bias);
+        synth_pulse(&train, TX_PULSE_LEVEL(n), us > 0 ? us : 0);
+      }
+    }
+    synth_pulse(&train, 0, BURST_GAP_US);
+
+    // Sampled at the decoder interval, the receiver takes the same samples from a copy of the random state
+    uint32_t phase = rng;
+    synth_sample(&sig, &train, RX_SAMPLE_INTERVAL_US, jitter, &rng);
+    for(unsigned long i = 0; i < sig.count; i++) {
+      if(frames_dec.sample(sig.samples[i])) rs.frames++;
+    }
+    rx.source.train = &train;
+    rx.source.rng = &phase;
+    rx.source.begin();
+    rx.sink.sent = raw;
+    rx.sink.packets = rx.sink.wrong = 0;
+    rx.run();
+    account(&rs, rx.sink.packets, rx.sink.wrong);
+
+    // Timed edges, the pulse widths are limited to 16 bits as in the input capture
+    for(unsigned long p = 0; p < train.count; p++) {
+      uint16_t us = train.pulses[p].us > 65535 ? 65535 : train.pulses[p].us;
+      uint8_t event = detectEdge(&edges_pd, train.pulses[p].level, us);
+      if(event != EVENT_NONE && edges_frame.push(event)) re.frames++;
+      if(decodeEdge(&edges_dec, train.pulses[p].level, us)) {
+        if(lastPacket(&edges_dec) == raw) packets++;
+        else wrong++;
+      }
+    }
+    account(&re, packets, wrong);
+
+    free(train.pulses);
+    free(sig.samples);
+  }
+
+  printf("interval_us=%d clock=%s bursts=%d repeats=%d bias_us=%ld jitter_us=%ld table_bytes=%u\n",
+         RX_SAMPLE_INTERVAL_US, CLOCK_RECOVERY ? "recovered" : "fixed", bursts, repeats, bias, jitter,
+         (unsigned)sizeof(tx_frame_t));
+  report("samples", &rs, bursts, repeats);
+  report("edges", &re, bursts, repeats);
+
+  // Jitter only applies to the sampled path, the edges are exact
+  return (rs.wrong || rs.missed || re.wrong || re.missed || re.frames != (unsigned long)bursts * repeats) ? 1 : 0;
+}
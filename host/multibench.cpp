@@ -0,0 +1,258 @@
+/**
+ * Receiver port benchmark - decode yield and cost per sample of up to 8 receivers read from one port
+ *
+ * Every scenario synthesizes bursts of repeated frames as several receivers at different places hear them: the same
+ * transmissions, but every receiver has its own edge jitter and its own realization of the channel model of synth.h.
+ * With a spread, the receivers further down the port get a weaker and noisier channel. The samples of all receivers
+ * are packed into port bytes (receiver i in bit i, as readRxPort() returns them) and decoded three ways:
+ *   detect    detectPulse() on every receiver, the pulse detection alone as the single receiver loop does it
+ *   separate  a full decoder (decodeSample()) per receiver, the packets of all receivers merged
+ *   port      decodePort(): bit-sliced pulse counters for all receivers, shared duplicate suppression
+ * plus the packets of receiver 0 alone for comparison (single). The receivers are decoded without voting in all
+ * paths (build with SOFT_DECODE=0, see the Makefile), so the packets found are comparable.
+ *
+ * One line per scenario and path with key=value pairs:
+ *   yield      bursts whose packet came out / bursts sent
+ *   false      packets which were not sent in the burst they were found in
+ *   ns/sample  time per port sample, all receivers together
+ *
+ * Usage: multibench [-b bursts] [-r repeats] [-n receivers] [-S scenario] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../config.h"
+#include "../decoder_full.h"
+#include "synth.h"
+
+// Silence between bursts, in us - long enough for the debouncer to forget the previous packet
+#define BURST_GAP_US 300000
+
+// Bursts synthesized and decoded at a time
+#define CHUNK_BURSTS 64
+
+// Paths
+#define PATH_SINGLE   0
+#define PATH_DETECT   1
+#define PATH_SEPARATE 2
+#define PATH_PORT     3
+#define PATHS         4
+
+static const char *path_names[PATHS] = { "single", "detect", "separate", "port" };
+
+typedef struct {
+  const char *name;
+  long jitter_us;           // Edge jitter
+  uint32_t weak_us;         // High pulses shortened by the receiver
+  synth_channel_t channel;  // Bit flips and noise bursts
+  int spread;               // Impairments grow by this percentage from one receiver to the next
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+  { "clean",     0,  0,  { 0,    0,  0,    0     }, 0  },
+  { "flips",     25, 0,  { 1000, 0,  0,    0     }, 0  },
+  { "noise",     25, 0,  { 0,    20, 2000, 0     }, 0  },
+  { "agc",       25, 0,  { 0,    0,  0,    20000 }, 0  },
+  { "placement", 25, 10, { 500,  5,  2000, 10000 }, 50 },
+  { "mixed",     50, 25, { 500,  10, 2000, 0     }, 0  },
+};
+#define SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Scale an impairment for a receiver
+ */
+static uint32_t spread(const scenario_t *sc, uint32_t val, int receiver) {
+  return (uint64_t)val * (100 + sc->spread * receiver) / 100;
+}
+
+/**
+ * Append a sample to a signal
+ */
+static void append(synth_signal_t *s, uint8_t val) {
+  if(s->count == s->cap) {
+    s->cap = s->cap ? s->cap * 2 : 65536;
+    s->samples = (uint8_t *)realloc(s->samples, s->cap);
+  }
+  s->samples[s->count++] = val;
+}
+
+/**
+ * Check a packet against the burst it was found in
+ */
+static void check(uint32_t raw, unsigned long at, const unsigned long *start, const uint32_t *sent, int n,
+                  uint8_t *found, unsigned long *good, unsigned long *bad) {
+  int b = 0;
+  while(b < n && at >= start[b + 1]) b++;
+  if(b == n || raw != sent[b]) {
+    (*bad)++;
+  } else if(!found[b]) {
+    found[b] = 1;
+    (*good)++;
+  }
+}
+
+static void run(const scenario_t *sc, int bursts, int repeats, int receivers, uint32_t rng) {
+  synth_signal_t sig[PORT_RECEIVERS];
+  uint32_t sent[CHUNK_BURSTS];
+  uint8_t found[PATHS][CHUNK_BURSTS];
+  unsigned long start[CHUNK_BURSTS + 1];
+  unsigned long good[PATHS] = { 0 }, bad[PATHS] = { 0 }, samples = 0, events = 0;
+  uint8_t *port = NULL;
+  double t[PATHS] = { 0 };
+
+  static pulse_detector_t detector[PORT_RECEIVERS];
+  static nexa_decoder_t decoder[PORT_RECEIVERS];
+  static nexa_port_decoder_t multi;
+
+  for(int i = 0; i < receivers; i++) {
+    sig[i].samples = NULL;
+    sig[i].cap = 0;
+    detector_init(&detector[i]);
+    decoder_init(&decoder[i]);
+  }
+  port_decoder_init(&multi, (1 << receivers) - 1);
+
+  for(int done = 0; done < bursts; done += CHUNK_BURSTS) {
+    int n = MIN(CHUNK_BURSTS, bursts - done);
+    unsigned long count = 0;
+    for(int i = 0; i < receivers; i++) sig[i].count = 0;
+
+    for(int b = 0; b < n; b++) {
+      synth_train_t train = { NULL, 0, 0 };
+      start[b] = count;
+      sent[b] = synth_rand(&rng);
+      for(int r = 0; r < repeats; r++) synth_frame(&train, sent[b], 0);
+      synth_pulse(&train, 0, BURST_GAP_US);
+
+      // The same transmission at every receiver, each with its own signal strength and jitter
+      for(int i = 0; i < receivers; i++) {
+        synth_train_t heard = { (synth_pulse_t *)malloc(train.count * sizeof(synth_pulse_t)), train.count, train.count };
+        memcpy(heard.pulses, train.pulses, train.count * sizeof(synth_pulse_t));
+        if(sc->weak_us) synth_attenuate(&heard, spread(sc, sc->weak_us, i));
+        synth_sample(&sig[i], &heard, RX_SAMPLE_INTERVAL_US, sc->jitter_us, &rng);
+        free(heard.pulses);
+        count = MAX(count, sig[i].count);
+      }
+      free(train.pulses);
+
+      // All receivers are sampled at the same time: the ones a sample short stay low until the next burst
+      for(int i = 0; i < receivers; i++) {
+        while(sig[i].count < count) append(&sig[i], 0);
+      }
+    }
+    start[n] = count;
+
+    port = (uint8_t *)realloc(port, count);
+    memset(port, 0, count);
+    for(int i = 0; i < receivers; i++) {
+      synth_channel_t ch = sc->channel;
+      ch.flip_ppm = spread(sc, ch.flip_ppm, i);
+      ch.noise_per_s = spread(sc, ch.noise_per_s, i);
+      ch.agc_ppm = spread(sc, ch.agc_ppm, i);
+      synth_corrupt(&sig[i], 0, &ch, &rng);
+      for(unsigned long k = 0; k < count; k++) port[k] |= sig[i].samples[k] << i;
+    }
+    memset(found, 0, sizeof(found));
+
+    // Pulse detection of every receiver alone, the events are counted so the work is not optimized away
+    double t0 = now();
+    for(unsigned long k = 0; k < count; k++) {
+      uint8_t val = port[k];
+      for(int i = 0; i < receivers; i++) events += detectPulse(&detector[i], (val >> i) & 0x1) != EVENT_NONE;
+    }
+    t[PATH_DETECT] += now() - t0;
+
+    // A full decoder per receiver; receiver 0 alone is the single receiver
+    t0 = now();
+    for(unsigned long k = 0; k < count; k++) {
+      uint8_t val = port[k];
+      for(int i = 0; i < receivers; i++) {
+        if(!decodeSample(&decoder[i], (val >> i) & 0x1)) continue;
+        uint32_t raw = lastPacket(&decoder[i]);
+        check(raw, k, start, sent, n, found[PATH_SEPARATE], &good[PATH_SEPARATE], &bad[PATH_SEPARATE]);
+        if(!i) check(raw, k, start, sent, n, found[PATH_SINGLE], &good[PATH_SINGLE], &bad[PATH_SINGLE]);
+      }
+    }
+    t[PATH_SEPARATE] += now() - t0;
+
+    // All receivers at once
+    t0 = now();
+    for(unsigned long k = 0; k < count; k++) {
+      uint8_t fresh = decodePort(&multi, port[k]);
+      if(!fresh) continue;
+      for(int i = 0; i < receivers; i++) {
+        if(fresh & (1 << i)) check(portPacket(&multi, i), k, start, sent, n, found[PATH_PORT], &good[PATH_PORT], &bad[PATH_PORT]);
+      }
+    }
+    t[PATH_PORT] += now() - t0;
+
+    samples += count;
+  }
+
+  for(int p = 0; p < PATHS; p++) {
+    printf("scenario=%s path=%s receivers=%d interval_us=%d decode=%s bursts=%d repeats=%d jitter_us=%ld weak_us=%u "
+           "flip_ppm=%u noise_per_s=%u noise_us=%u agc_ppm=%u spread=%d", sc->name, path_names[p], p ? receivers : 1,
+           RX_SAMPLE_INTERVAL_US, SOFT_DECODE ? "soft" : "hard", bursts, repeats, sc->jitter_us, sc->weak_us,
+           sc->channel.flip_ppm, sc->channel.noise_per_s, sc->channel.noise_us, sc->channel.agc_ppm, sc->spread);
+    if(p == PATH_DETECT) {
+      printf(" events=%lu", events);
+    } else {
+      printf(" decoded=%lu yield=%.3f%% false=%lu", good[p], 100.0 * good[p] / bursts, bad[p]);
+    }
+    // The single receiver is not timed on its own, it is part of the separate decoders
+    if(p == PATH_SINGLE) printf(" samples=%lu\n", samples);
+    else printf(" samples=%lu ns/sample=%.2f\n", samples, t[p] * 1e9 / samples);
+  }
+  fflush(stdout);
+
+  for(int i = 0; i < receivers; i++) free(sig[i].samples);
+  free(port);
+}
+
+int main(int argc, char **argv) {
+  int bursts = 2000, repeats = 5, receivers = PORT_RECEIVERS, opt;
+  const char *only = NULL;
+  uint32_t rng = 12345;
+
+  while((opt = getopt(argc, argv, "b:r:n:S:s:")) != -1) {
+    switch(opt) {
+      case 'b': bursts = atoi(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      case 'n': receivers = atoi(optarg); break;
+      case 'S': only = optarg; break;
+      case 's': rng = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-b bursts] [-r repeats] [-n receivers] [-S scenario] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  if(receivers < 1 || receivers > PORT_RECEIVERS) {
+    fprintf(stderr, "Between 1 and %d receivers\n", PORT_RECEIVERS);
+    return 2;
+  }
+
+  int found = 0;
+  for(unsigned i = 0; i < SCENARIOS; i++) {
+    if(only && strcmp(only, scenarios[i].name)) continue;
+    // Every scenario starts from the same seed so a change in one does not move the others
+    run(&scenarios[i], bursts, repeats, receivers, rng);
+    found = 1;
+  }
+
+  if(!found) {
+    fprintf(stderr, "Unknown scenario %s\n", only);
+    return 2;
+  }
+  return 0;
+}
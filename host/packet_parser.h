@@ -0,0 +1,80 @@
+/**
+ * Packet stream parser - reads the binary output of the full decoder (OUTPUT_BINARY, see packet_frame.h)
+ *
+ * Bytes are pushed one at a time, complete frames with a valid CRC come out as packets. The parser only uses its
+ * own fixed buffer, so a stream of any length is parsed without allocating. When a frame does not check out, the
+ * bytes after its sync byte are searched for the next frame, so the parser recovers from lost or corrupted bytes
+ * (and from starting in the middle of a frame).
+ */
+
+#ifndef _PACKET_PARSER_H_
+#define _PACKET_PARSER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../protocol.h"
+#include "../packet_frame.h"
+
+// A received packet
+typedef struct {
+  nexa_pckt_t packet;
+  uint32_t raw;          // The same packet as a number
+  uint32_t time_ms;      // millis() on the board when the first frame was received
+  uint8_t repeats;       // Frames received
+  uint8_t dropped;       // Packets dropped by the board so far (wraps at 256)
+} packet_t;
+
+typedef struct {
+  uint8_t buf[PACKET_FRAME_SIZE];
+  uint8_t len;
+  unsigned long frames;        // Valid frames
+  unsigned long crc_errors;    // Frames with a sync byte that did not check out
+  unsigned long skipped;       // Bytes outside of any frame
+} packet_parser_t;
+
+static inline void packet_parser_init(packet_parser_t *p) {
+  memset(p, 0, sizeof(*p));
+}
+
+/**
+ * Drop the first n bytes of the buffer and continue from the next sync byte after them
+ */
+static inline void packet_parser_resync(packet_parser_t *p, uint8_t n) {
+  while(n < p->len && p->buf[n] != PACKET_FRAME_SYNC) n++;
+  p->skipped += n;
+  memmove(p->buf, p->buf + n, p->len - n);
+  p->len -= n;
+}
+
+/**
+ * Push one byte of the stream
+ * @return 1 when a frame is complete, *out holds the packet
+ */
+static inline uint8_t packet_parser_push(packet_parser_t *p, uint8_t byte, packet_t *out) {
+  if(p->len == 0 && byte != PACKET_FRAME_SYNC) {
+    p->skipped++;
+    return 0;
+  }
+  p->buf[p->len++] = byte;
+
+  if(p->len == PACKET_FRAME_SIZE) {
+    if(packet_frame_crc(p->buf) == p->buf[PACKET_FRAME_CRC]) {
+      out->raw = packet_frame_get32(p->buf + PACKET_FRAME_RAW);
+      memcpy(&out->packet, &out->raw, sizeof(out->packet));
+      out->time_ms = packet_frame_get32(p->buf + PACKET_FRAME_TIME);
+      out->repeats = p->buf[PACKET_FRAME_REPEATS];
+      out->dropped = p->buf[PACKET_FRAME_DROPPED];
+      p->len = 0;
+      p->frames++;
+      return 1;
+    }
+
+    // Not a frame after all: the sync byte was part of something else
+    p->crc_errors++;
+    packet_parser_resync(p, 1);
+  }
+  return 0;
+}
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * Packet dump - prints the packets of a binary output stream of the full decoder (OUTPUT_BINARY)
+ *
+ * Reads a capture of the serial port (or stdin) through the packet parser and prints every packet in the text
+ * format of the decoder, with the board time and the number of repeats. With -t it checks the parser instead:
+ * random packets are framed, the stream is corrupted with random bytes and the packets found are compared to
+ * the ones sent, along with the parsing speed.
+ *
+ * Usage: pktdump [file]
+ *        pktdump -t [-n packets] [-e error_ppm] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "packet_parser.h"
+#include "synth.h"
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Frame random packets, corrupt the stream and parse it back
+ */
+static int selftest(unsigned long packets, uint32_t error_ppm, uint32_t rng) {
+  unsigned long size = packets * PACKET_FRAME_SIZE;
+  uint8_t *stream = (uint8_t *)malloc(size);
+  uint32_t *sent = (uint32_t *)malloc(packets * sizeof(uint32_t));
+  unsigned long corrupted = 0;
+
+  for(unsigned long i = 0; i < packets; i++) {
+    uint8_t *f = stream + i * PACKET_FRAME_SIZE;
+    sent[i] = synth_rand(&rng);
+    packet_frame_fill(f, sent[i], i * 100, 5, 0);
+    f[PACKET_FRAME_CRC] = packet_frame_crc(f);
+  }
+  for(unsigned long i = 0; i < size; i++) {
+    if(synth_rand(&rng) % 1000000 < error_ppm) {
+      stream[i] = synth_rand(&rng);
+      corrupted++;
+    }
+  }
+
+  // Every packet carries its index in the time field, so a wrong packet is told apart from a lost one
+  packet_parser_t parser;
+  packet_t pkt;
+  unsigned long good = 0, bad = 0;
+  packet_parser_init(&parser);
+
+  double t = now();
+  for(unsigned long i = 0; i < size; i++) {
+    if(packet_parser_push(&parser, stream[i], &pkt)) {
+      unsigned long n = pkt.time_ms / 100;
+      if(n < packets && sent[n] == pkt.raw) good++; else bad++;
+    }
+  }
+  t = now() - t;
+
+  printf("packets=%lu bytes=%lu corrupted=%lu found=%lu wrong=%lu crc_errors=%lu skipped=%lu ns/byte=%.2f\n",
+         packets, size, corrupted, good, bad, parser.crc_errors, parser.skipped, t * 1e9 / size);
+
+  free(stream);
+  free(sent);
+  // Without corruption every packet has to come through; with it, an 8 bit CRC lets about 1 in 256 bad frames pass
+  return (!error_ppm && (bad || good != packets)) ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  int test = 0, opt;
+  unsigned long packets = 1000000;
+  uint32_t error_ppm = 0, rng = 12345;
+
+  while((opt = getopt(argc, argv, "tn:e:s:")) != -1) {
+    switch(opt) {
+      case 't': test = 1; break;
+      case 'n': packets = strtoul(optarg, NULL, 0); break;
+      case 'e': error_ppm = strtoul(optarg, NULL, 0); break;
+      case 's': rng = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [file]\n       %s -t [-n packets] [-e error_ppm] [-s seed]\n", argv[0], argv[0]);
+        return 2;
+    }
+  }
+  if(test) return selftest(packets, error_ppm, rng);
+
+  FILE *f = stdin;
+  if(optind < argc && !(f = fopen(argv[optind], "rb"))) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  packet_parser_t parser;
+  packet_t pkt;
+  int c;
+  packet_parser_init(&parser);
+
+  while((c = fgetc(f)) != EOF) {
+    if(!packet_parser_push(&parser, c, &pkt)) continue;
+    printf("%10.3f s: %X:%X group:%X channel: %X on:%X repeats:%u dropped:%u\n",
+           pkt.time_ms / 1000.0, pkt.packet.device_id, pkt.packet.unit, pkt.packet.group, pkt.packet.channel,
+           pkt.packet.on_off, pkt.repeats, pkt.dropped);
+    fflush(stdout);
+  }
+
+  fprintf(stderr, "frames=%lu crc_errors=%lu skipped=%lu\n", parser.frames, parser.crc_errors, parser.skipped);
+  if(f != stdin) fclose(f);
+  return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * Multi-protocol benchmark - what every extra protocol in a decoder set costs per sample
+ *
+ * Synthesizes bursts of Nexa, Proove/Anslut and Nexa dimmer frames in random order, then decodes them with one pass
+ * of the pulse detector feeding decoder sets of a growing number of protocols. Reports the frames found per protocol
+ * and the decoding cost per sample; the set of Nexa copies isolates the cost of one more frame decoder.
+ *
+ * Usage: protobench [-b bursts] [-r repeats] [-j jitter_us] [-n passes] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../config.h"
+#include "../frame_decoder.h"
+#include "synth.h"
+
+// Silence between bursts, in us
+#define BURST_GAP_US 300000
+
+// Protocols in the synthesized traffic
+enum { PROTO_NEXA, PROTO_PROOVE, PROTO_DIMMER, PROTOS };
+static const char *names[PROTOS] = { "nexa", "proove", "dimmer" };
+
+static synth_signal_t sig = { NULL, 0, 0 };
+static int passes = 3;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Decode the signal with one decoder set, count the frames per protocol in the set
+ * @return decoding time per sample in ns, the best of all passes
+ */
+template<typename... Ps>
+static double run(const char *label, unsigned long *found) {
+  multi_decoder<Ps...> decoder;
+  double best = 0;
+
+  for(int pass = 0; pass < passes; pass++) {
+    for(unsigned i = 0; i < sizeof...(Ps); i++) found[i] = 0;
+    decoder.init();
+
+    double t = now();
+    for(unsigned long i = 0; i < sig.count; i++) {
+      uint8_t res = decoder.sample(sig.samples[i]);
+      // Frames are rare, counting them does not show in the timing
+      for(uint8_t p = 0; res; p++, res >>= 1) found[p] += res & 0x1;
+    }
+    t = now() - t;
+    if(pass == 0 || t < best) best = t;
+  }
+
+  printf("%-28s protocols=%u ns/sample=%.2f frames=", label, (unsigned)sizeof...(Ps), best * 1e9 / sig.count);
+  for(unsigned i = 0; i < sizeof...(Ps); i++) printf("%s%lu", i ? "/" : "", found[i]);
+  printf("\n");
+  return best * 1e9 / sig.count;
+}
+
+int main(int argc, char **argv) {
+  int bursts = 1000, repeats = 5, opt;
+  long jitter = 25;
+  uint32_t rng = 12345;
+  unsigned long sent[PROTOS] = { 0 }, found[8];
+
+  while((opt = getopt(argc, argv, "b:r:j:n:s:")) != -1) {
+    switch(opt) {
+      case 'b': bursts = atoi(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      case 'j': jitter = atol(optarg); break;
+      case 'n': passes = atoi(optarg); break;
+      case 's': rng = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-b bursts] [-r repeats] [-j jitter_us] [-n passes] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+  if(passes < 1) passes = 1;
+
+  // Mixed traffic: Nexa remotes never send channel 00, which is what tells Proove/Anslut apart
+  for(int b = 0; b < bursts; b++) {
+    synth_train_t train = { NULL, 0, 0 };
+    int proto = synth_rand(&rng) % PROTOS;
+    uint64_t raw = synth_rand(&rng);
+
+    for(int r = 0; r < repeats; r++) {
+      switch(proto) {
+        case PROTO_NEXA:   synth_frame(&train, raw | 0xC, 0); break;
+        case PROTO_PROOVE: synth_frame(&train, raw & ~0xCUL, 0); break;
+        case PROTO_DIMMER: synth_frame_bits(&train, (raw << 4) | (b & 0xF), 36, nexa_dimmer_protocol::dim_symbol, 0); break;
+      }
+    }
+    synth_pulse(&train, 0, BURST_GAP_US);
+    sent[proto]++;
+
+    synth_sample(&sig, &train, RX_SAMPLE_INTERVAL_US, jitter, &rng);
+    free(train.pulses);
+  }
+
+  printf("interval_us=%d samples=%lu bursts=%d repeats=%d sent=%lu/%lu/%lu (%s/%s/%s)\n",
+         RX_SAMPLE_INTERVAL_US, sig.count, bursts, repeats,
+         sent[PROTO_NEXA], sent[PROTO_PROOVE], sent[PROTO_DIMMER], names[0], names[1], names[2]);
+
+  // Real protocols, one more at a time
+  run<nexa_protocol>("nexa", found);
+  run<nexa_protocol, proove_protocol>("nexa+proove", found);
+  run<nexa_protocol, proove_protocol, nexa_dimmer_protocol>("nexa+proove+dimmer", found);
+
+  // The same protocol several times: the difference is the cost of one more frame decoder
+  double one = run<nexa_protocol>("nexa x1", found);
+  double eight = run<nexa_protocol, nexa_protocol, nexa_protocol, nexa_protocol,
+                     nexa_protocol, nexa_protocol, nexa_protocol, nexa_protocol>("nexa x8", found);
+  printf("cost per extra protocol: %.3f ns/sample\n", (eight - one) / 7);
+
+  free(sig.samples);
+  return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ * Recorder benchmark - how much traffic fits in the buffer of the run-length recorder
+ *
+ * Every scenario synthesizes bursts of repeated frames with random packets, separated by silence, passes them through
+ * the channel model of synth.h and records the samples as the run-length recorder does (RECORDER_RLE in recorder.h):
+ * the width of every pulse goes into a buffer of RECORDER_RLE_BYTES until it is full or RECORDER_RLE_SECONDS have
+ * passed. Two codes are compared on the same samples:
+ *   vlq     one variable length number per pulse, 7 bits per byte (the code the recorder used before)
+ *   prefix  the code of rle.h, a few bits per pulse near the protocol timing
+ *
+ * One line per scenario and code with key=value pairs:
+ *   frames    frames recorded up to their last high pulse
+ *   bursts    bursts recorded with all their repeats
+ *   seconds   time recorded until the buffer was full
+ *
+ * With -o the prefix code buffer of the last scenario run is written as the hex dump the recorder prints, for replay -r.
+ *
+ * Usage: recbench [-b bursts] [-r repeats] [-g gap_ms] [-S scenario] [-s seed] [-o dump]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../config.h"
+#include "../recorder.h"
+#include "../rle.h"
+#include "synth.h"
+
+// Codes
+#define CODE_VLQ    0
+#define CODE_PREFIX 1
+#define CODES       2
+
+static const char *code_names[CODES] = { "vlq", "prefix" };
+
+typedef struct {
+  const char *name;
+  long jitter_us;           // Edge jitter
+  int skew;                 // Clock error of each transmitter, random up to this percentage
+  synth_channel_t channel;  // Bit flips and noise bursts
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+  { "clean",    0,  0,  { 0,    0,  0,    0     } },
+  { "jitter",   25, 0,  { 0,    0,  0,    0     } },
+  { "jitter50", 50, 0,  { 0,    0,  0,    0     } },
+  { "skew",     25, 15, { 0,    0,  0,    0     } },
+  { "flips",    25, 0,  { 1000, 0,  0,    0     } },
+  { "noise",    25, 0,  { 0,    20, 2000, 0     } },
+  { "agc",      25, 0,  { 0,    0,  0,    20000 } },
+};
+#define SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+// Recording in one code
+typedef struct {
+  uint8_t buf[RECORDER_RLE_BYTES];
+  rle_writer_t rle;         // Prefix code, behind the first byte
+  uint16_t pos;             // Vlq code, next byte after the first
+  uint8_t full;             // Set once a pulse did not fit
+  unsigned long stored;     // Samples of the pulses stored
+} recording_t;
+
+/**
+ * Store a pulse in a code, as recorder.cpp does
+ * @return 0 when it does not fit
+ */
+static uint8_t store(recording_t *r, int code, uint8_t level, uint32_t run) {
+  if(code == CODE_PREFIX) return rle_push(&r->rle, level, run);
+
+  // Always keep room for the longest number (5 bytes for 32 bits)
+  if(r->pos + 5 > RECORDER_RLE_BYTES) return 0;
+  while(run >= 0x80) {
+    r->buf[r->pos++] = (run & 0x7F) | 0x80;
+    run >>= 7;
+  }
+  r->buf[r->pos++] = run;
+  return 1;
+}
+
+/**
+ * Write a recording as the hex dump of recorder.cpp
+ */
+static int dump(const char *name, const uint8_t *buf, uint16_t bytes) {
+  FILE *f = fopen(name, "w");
+  if(!f) return 0;
+
+  fprintf(f, "Recording complete\nRLE bytes: %u\n", bytes);
+  for(uint16_t i = 0; i < bytes; i++) {
+    fprintf(f, "%02X", buf[i]);
+    if(i % 32 == 31) fprintf(f, "\n");
+  }
+  fprintf(f, "\n");
+  return fclose(f) == 0;
+}
+
+static void run(const scenario_t *sc, int bursts, int repeats, long gap_ms, uint32_t rng, const char *out) {
+  static recording_t rec[CODES];
+  unsigned long *frame_end = (unsigned long *)malloc(bursts * repeats * sizeof(unsigned long));
+  unsigned long total = 0, frames = 0;
+  uint32_t pulse = 0;
+  uint8_t level = 0;
+  int sent = 0;
+
+  for(int c = 0; c < CODES; c++) {
+    rec[c].pos = 0;
+    rec[c].full = 0;
+    rec[c].stored = 0;
+    rle_init(&rec[c].rle, rec[c].buf + 1, RECORDER_RLE_BYTES - 1);
+  }
+
+  // Bursts until both buffers are full
+  for(; sent < bursts && !(rec[CODE_VLQ].full && rec[CODE_PREFIX].full); sent++) {
+    synth_train_t train = { NULL, 0, 0 };
+    synth_signal_t sig = { NULL, 0, 0 };
+    uint32_t raw = synth_rand(&rng);
+    int skew = synth_jitter(&rng, sc->skew);
+    double us = 0;
+
+    // A frame is recorded once its final high pulse is, the pause follows it
+    for(int r = 0; r < repeats; r++) {
+      synth_frame(&train, raw, skew);
+      us = 0;
+      for(unsigned long p = 0; p < train.count; p++) us += train.pulses[p].us;
+      frame_end[frames++] = total + (unsigned long)((us - SYNTH_REPEAT_PAUSE_US) / RX_SAMPLE_INTERVAL_US);
+    }
+    synth_pulse(&train, 0, gap_ms * 1000);
+    synth_sample(&sig, &train, RX_SAMPLE_INTERVAL_US, sc->jitter_us, &rng);
+    synth_corrupt(&sig, 0, &sc->channel, &rng);
+    free(train.pulses);
+
+    for(unsigned long k = 0; k < sig.count; k++, total++) {
+      if(total == 0) {
+        // The first byte holds the level of the first pulse
+        level = sig.samples[0];
+        for(int c = 0; c < CODES; c++) rec[c].buf[0] = level;
+        rec[CODE_VLQ].pos = 1;
+      }
+      if(total == RECORDER_RLE_SAMPLES) {
+        for(int c = 0; c < CODES; c++) rec[c].full = 1;
+        break;
+      }
+      if(sig.samples[k] != level) {
+        for(int c = 0; c < CODES; c++) {
+          if(rec[c].full) continue;
+          if(store(&rec[c], c, level, pulse)) rec[c].stored = total;
+          else rec[c].full = 1;
+        }
+        level = sig.samples[k];
+        pulse = 0;
+      }
+      pulse++;
+    }
+    free(sig.samples);
+    if(total == RECORDER_RLE_SAMPLES) break;
+  }
+
+  for(int c = 0; c < CODES; c++) {
+    unsigned long f = 0;
+    while(f < frames && frame_end[f] <= rec[c].stored) f++;
+    uint16_t bytes = c == CODE_PREFIX ? 1 + (rec[c].rle.pos + 7) / 8 : rec[c].pos;
+    printf("scenario=%s code=%s interval_us=%d buffer_bytes=%d repeats=%d gap_ms=%ld jitter_us=%ld skew=%d "
+           "flip_ppm=%u noise_per_s=%u noise_us=%u agc_ppm=%u full=%s bytes=%u frames=%lu bursts=%lu seconds=%.1f "
+           "bytes/frame=%.1f\n", sc->name, code_names[c], RX_SAMPLE_INTERVAL_US, RECORDER_RLE_BYTES, repeats, gap_ms,
+           sc->jitter_us, sc->skew, sc->channel.flip_ppm, sc->channel.noise_per_s, sc->channel.noise_us,
+           sc->channel.agc_ppm, rec[c].full ? "yes" : "no", bytes, f, f / repeats,
+           rec[c].stored * (RX_SAMPLE_INTERVAL_US / 1e6), f ? (double)bytes / f : 0.0);
+  }
+  fflush(stdout);
+
+  if(out && !dump(out, rec[CODE_PREFIX].buf, 1 + rle_finish(&rec[CODE_PREFIX].rle))) {
+    fprintf(stderr, "Could not write %s\n", out);
+  }
+  free(frame_end);
+}
+
+int main(int argc, char **argv) {
+  int bursts = 1000, repeats = 5, opt;
+  long gap_ms = 1000;
+  const char *only = NULL, *out = NULL;
+  uint32_t rng = 12345;
+
+  while((opt = getopt(argc, argv, "b:r:g:S:s:o:")) != -1) {
+    switch(opt) {
+      case 'b': bursts = atoi(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      case 'g': gap_ms = atol(optarg); break;
+      case 'S': only = optarg; break;
+      case 's': rng = strtoul(optarg, NULL, 0) | 1; break;
+      case 'o': out = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-b bursts] [-r repeats] [-g gap_ms] [-S scenario] [-s seed] [-o dump]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  int found = 0;
+  for(unsigned i = 0; i < SCENARIOS; i++) {
+    if(only && strcmp(only, scenarios[i].name)) continue;
+    // Every scenario starts from the same seed so a change in one does not move the others
+    run(&scenarios[i], bursts, repeats, gap_ms, rng, out);
+    found = 1;
+  }
+
+  if(!found) {
+    fprintf(stderr, "Unknown scenario %s\n", only);
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,556 @@
+/**
+ * Host replay tool - pushes recorded sample streams through the decoder at full CPU speed
+ *
+ * Reads the bit stream as recorded by the recorder module (8 samples per byte, first sample in
+ * the most significant bit) and feeds it to the same decoder logic as the full decoder module.
+ * Use this to regression-test decoder changes against long captures without flashing a board.
+ *
+ * Usage: replay [-a] [-r] [-s] [-A] [-T] [-e] [-w] [-q] [-n passes] [-j threads] [-S threads] <capture> [capture...]
+ *        replay [-e] [-w] [-n passes] [-S threads] -y bursts
+ *   -a  input is the ASCII dump printed by recorder_loop() ("0 1 1 0 ...") instead of packed bytes
+ *   -r  input is the hex dump of the run-length recorder (RECORDER_RLE)
+ *   -s  input is the binary output of the streaming recorder (RECORDER_STREAM)
+ *   -A  input is a raw ADC trace: one reading per sample, the top 8 bits of the 10 bit conversion; the readings
+ *       are sliced with the fixed analog thresholds from sampler.h first (the same slicer as analog_source in
+ *       receiver.h); combined with -s the stream blocks carry the readings (RECORDER_STREAM_RAW)
+ *   -T  as -A, but slice with the adaptive thresholds (RX_ANALOG_ADAPTIVE); compare the packets found by both
+ *   -e  feed the pulse widths to the edge decoder (decodeEdge) instead of the samples to decodeSample
+ *   -w  extract the run lengths 64 samples at a time and feed them to decodeRun (bulk decoding)
+ *   -q  do not print the decoded packets, only the statistics
+ *   -n  decode the captures this many times (for more stable timing figures)
+ *   -j  decode this many captures in parallel, each thread runs its own decoder context
+ *   -S  scaling: decode the captures with 1 up to this many threads, every thread its own copy of all of them, and
+ *       print one key=value line per thread count with the packets/s and the speedup over one thread; with the
+ *       same work per thread the packets/s grow with the threads for as long as there are cores
+ *   -y  instead of reading captures, synthesize one with this many bursts of random packets (host/synth.h)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../config.h"
+#include "../decoder_full.h"
+#include "../recorder.h"
+#include "../rle.h"
+#include "synth.h"
+
+// Sample stream as loaded from a capture: packed, 8 samples per byte, MSB first
+typedef struct {
+  uint8_t *data;
+  unsigned long samples;
+} capture_t;
+
+/**
+ * Load a packed capture as-is
+ */
+static int loadPacked(FILE *f, capture_t *c) {
+  unsigned long size = 0, cap = 0;
+  size_t n;
+
+  c->data = NULL;
+  do {
+    if(size == cap) {
+      cap = cap ? cap * 2 : 65536;
+      c->data = (uint8_t *)realloc(c->data, cap);
+      if(!c->data) return 0;
+    }
+    n = fread(c->data + size, 1, cap - size, f);
+    size += n;
+  } while(n > 0);
+
+  c->samples = size * 8;
+  return 1;
+}
+
+/**
+ * Append a run of samples of the same level to a capture
+ */
+static int appendRun(capture_t *c, unsigned long *cap, uint8_t level, unsigned long run) {
+  unsigned long need = (c->samples + run + 7) / 8;
+
+  if(need > *cap) {
+    unsigned long old = *cap;
+    while(*cap < need) *cap = *cap ? *cap * 2 : 65536;
+    c->data = (uint8_t *)realloc(c->data, *cap);
+    if(!c->data) return 0;
+    memset(c->data + old, 0, *cap - old);
+  }
+  for(; run > 0; run--, c->samples++) {
+    if(level) c->data[c->samples / 8] |= 0x80 >> (c->samples % 8);
+  }
+  return 1;
+}
+
+/**
+ * Load the hex dump of the run-length recorder: lines with only hex digits are data, other text is skipped.
+ * The first byte is the level of the first pulse, followed by the pulse widths in the code of rle.h.
+ */
+static int loadRle(FILE *f, capture_t *c) {
+  unsigned long cap = 0, size = 0, bytes = 0;
+  uint8_t *buf = NULL;
+  char line[256];
+
+  c->data = NULL;
+  c->samples = 0;
+  while(fgets(line, sizeof(line), f)) {
+    size_t len = strcspn(line, "\r\n");
+    if(len == 0 || len % 2 || strspn(line, "0123456789abcdefABCDEF") != len) continue;
+
+    for(size_t i = 0; i < len; i += 2) {
+      unsigned int byte;
+      sscanf(line + i, "%2x", &byte);
+      if(bytes == size) {
+        size = size ? size * 2 : 4096;
+        buf = (uint8_t *)realloc(buf, size);
+        if(!buf) return 0;
+      }
+      buf[bytes++] = byte;
+    }
+  }
+  if(!bytes) return 1;
+
+  // Every run has the opposite level of the one before
+  rle_reader_t r;
+  uint8_t level = buf[0] & 0x1;
+  uint32_t run;
+  rle_reader_init(&r, buf + 1, bytes - 1);
+  for(; rle_next(&r, level, &run); level ^= 1) {
+    if(!appendRun(c, &cap, level, run)) {
+      free(buf);
+      return 0;
+    }
+  }
+  free(buf);
+  return 1;
+}
+
+/**
+ * Load a capture of the streaming recorder: blocks of packed samples behind a sync header. Lost blocks (sequence
+ * gaps), blocks dropped by the recorder and late samples are reported, the samples are concatenated as they are.
+ */
+static int loadStream(FILE *f, const char *name, capture_t *c) {
+  capture_t raw;
+  unsigned long pos = 0, blocks = 0, lost = 0, late = 0;
+  uint8_t expect = 0, dropped = 0;
+
+  if(!loadPacked(f, &raw)) return 0;
+  unsigned long size = raw.samples / 8;
+
+  c->data = (uint8_t *)malloc(size ? size : 1);
+  c->samples = 0;
+  if(!c->data) return 0;
+
+  while(pos + RECORDER_STREAM_HEADER + RECORDER_STREAM_BLOCK <= size) {
+    const uint8_t *b = raw.data + pos;
+    if(b[0] != RECORDER_STREAM_SYNC0 || b[1] != RECORDER_STREAM_SYNC1) {
+      // Not at a block (text before the stream or a corrupted block) - search for the next header
+      pos++;
+      continue;
+    }
+
+    if(blocks > 0) lost += (uint8_t)(b[2] - expect);
+    expect = b[2] + 1;
+    dropped = b[3];
+    late += b[4];
+    blocks++;
+
+    memcpy(c->data + c->samples / 8, b + RECORDER_STREAM_HEADER, RECORDER_STREAM_BLOCK);
+    c->samples += RECORDER_STREAM_BLOCK * 8;
+    pos += RECORDER_STREAM_HEADER + RECORDER_STREAM_BLOCK;
+  }
+  free(raw.data);
+
+  fprintf(stderr, "%s: %lu blocks, %lu missing (%u dropped by the recorder), %lu late samples\n",
+          name, blocks, lost, dropped, late);
+  return 1;
+}
+
+/**
+ * Load the ASCII dump of recorder_loop(); only the "0" and "1" tokens are samples, all other text
+ * (banners, sample counts) is skipped
+ */
+static int loadAscii(FILE *f, capture_t *c) {
+  unsigned long cap = 0;
+  char tok[32];
+
+  c->data = NULL;
+  c->samples = 0;
+  while(fscanf(f, "%31s", tok) == 1) {
+    if((tok[0] != '0' && tok[0] != '1') || tok[1] != 0) continue;
+
+    if(c->samples / 8 == cap) {
+      unsigned long old = cap;
+      cap = cap ? cap * 2 : 65536;
+      c->data = (uint8_t *)realloc(c->data, cap);
+      if(!c->data) return 0;
+      memset(c->data + old, 0, cap - old);
+    }
+    if(tok[0] == '1') c->data[c->samples / 8] |= 0x80 >> (c->samples % 8);
+    c->samples++;
+  }
+  return 1;
+}
+
+/**
+ * Slice a raw ADC trace (one reading per byte) into a packed capture
+ */
+static int sliceAdc(capture_t *c, int adaptive) {
+  unsigned long readings = c->samples / 8;
+  uint8_t *packed = (uint8_t *)calloc(readings / 8 + 1, 1);
+  slicer_t slicer;
+
+  if(!packed) return 0;
+  slicer_init(&slicer, RX_ANALOG_LEVEL_HIGH, RX_ANALOG_LEVEL_LOW);
+  for(unsigned long i = 0; i < readings; i++) {
+    uint16_t val = (uint16_t)c->data[i] << 2;
+    if(adaptive ? slicer_adapt(&slicer, val) : slicer_step(&slicer, val)) packed[i / 8] |= 0x80 >> (i % 8);
+  }
+
+  free(c->data);
+  c->data = packed;
+  c->samples = readings;
+  return 1;
+}
+
+/**
+ * Synthesize a capture: bursts of 5 frames of a random packet with 25 us of edge jitter, 200 ms apart
+ */
+static int synthesize(capture_t *c, int bursts) {
+  synth_train_t train = { NULL, 0, 0 };
+  synth_signal_t sig = { NULL, 0, 0 };
+  uint32_t rng = 12345;
+
+  for(int b = 0; b < bursts; b++) {
+    uint32_t raw = synth_rand(&rng);
+    for(int r = 0; r < 5; r++) synth_frame(&train, raw, 0);
+    synth_pulse(&train, 0, 200000);
+  }
+  synth_sample(&sig, &train, RX_SAMPLE_INTERVAL_US, 25, &rng);
+  free(train.pulses);
+
+  c->samples = sig.count;
+  c->data = (uint8_t *)calloc((sig.count + 7) / 8, 1);
+  if(!c->data) return 0;
+  for(unsigned long i = 0; i < sig.count; i++) {
+    if(sig.samples[i]) c->data[i / 8] |= 0x80 >> (i % 8);
+  }
+  free(sig.samples);
+  return 1;
+}
+
+// Decode job: one capture, decoded by one thread with its own decoder context
+typedef struct {
+  const char *name;
+  capture_t capture;
+  unsigned long packets;       // Packets found over all passes
+} job_t;
+
+// Settings shared by all threads
+static int edges = 0, words = 0, quiet = 0, passes = 1, names = 0;
+static job_t *jobs;
+static int num_jobs;
+static int next_job = 0;
+
+/**
+ * Print a packet the same way the full decoder module does, prefixed with the capture time
+ */
+static void printPacket(const job_t *job, const nexa_decoder_t *d, unsigned long sample) {
+  uint32_t raw = lastPacket(d);
+  nexa_pckt_t *p = (nexa_pckt_t *)&raw;
+
+  // One printf per packet so lines of different threads do not mix
+  printf("%s%s%12.6f s: %X:%X group:%X channel: %X on:%X\n",
+         names ? job->name : "", names ? ": " : "",
+         (double)sample * RX_SAMPLE_INTERVAL_US / 1e6,
+         p->device_id, p->unit, p->group, p->channel, p->on_off);
+}
+
+/**
+ * Decode a capture sample by sample
+ */
+static unsigned long replaySamples(const job_t *job, nexa_decoder_t *d, int print) {
+  const capture_t *c = &job->capture;
+  unsigned long packets = 0;
+
+  for(unsigned long i = 0; i < c->samples; i++) {
+    uint8_t val = (c->data[i / 8] >> (7 - i % 8)) & 0x1;
+    if(decodeSample(d, val)) {
+      packets++;
+      if(print) printPacket(job, d, i);
+    }
+  }
+  return packets;
+}
+
+/**
+ * Decode a capture as the input capture would see it: one call per pulse with the pulse width
+ */
+static unsigned long replayEdges(const job_t *job, nexa_decoder_t *d, int print) {
+  const capture_t *c = &job->capture;
+  unsigned long packets = 0;
+  unsigned long run = 0;
+  uint8_t level = c->data[0] >> 7;
+
+  for(unsigned long i = 0; i < c->samples; i++) {
+    uint8_t val = (c->data[i / 8] >> (7 - i % 8)) & 0x1;
+    if(val != level) {
+      unsigned long us = run * RX_SAMPLE_INTERVAL_US;
+      if(decodeEdge(d, level, us > 0xFFFF ? 0xFFFF : us)) {
+        packets++;
+        if(print) printPacket(job, d, i);
+      }
+      level = val;
+      run = 0;
+    }
+    run++;
+  }
+  return packets;
+}
+
+/**
+ * Load 64 samples, the first sample in the most significant bit; samples past the end read as 0
+ */
+static inline uint64_t loadWord(const capture_t *c, unsigned long word) {
+  unsigned long byte = word * 8, bytes = (c->samples + 7) / 8;
+  uint64_t w;
+
+  if(byte + 8 <= bytes) {
+    memcpy(&w, c->data + byte, 8);
+    return __builtin_bswap64(w);
+  }
+  w = 0;
+  for(int i = 0; i < 8; i++) {
+    w <<= 8;
+    if(byte + i < bytes) w |= c->data[byte + i];
+  }
+  return w;
+}
+
+/**
+ * Decode a capture by run lengths, found 64 samples at a time: the leading zero count of the word (inverted for
+ * a high level) is the number of samples until the next edge, so there is no work per sample at all
+ */
+static unsigned long replayWords(const job_t *job, nexa_decoder_t *d, int print) {
+  const capture_t *c = &job->capture;
+  unsigned long packets = 0;
+  unsigned long words = (c->samples + 63) / 64;
+  uint32_t run = 0;
+  uint8_t level = c->data[0] >> 7;
+
+  for(unsigned long i = 0; i < words; i++) {
+    uint64_t w = loadWord(c, i);
+    int left = i + 1 < words ? 64 : c->samples - i * 64;
+
+    while(1) {
+      // Bits which differ from the current level are set
+      uint64_t x = level ? ~w : w;
+      int n = x ? __builtin_clzll(x) : 64;
+
+      if(n >= left) {
+        // The run continues into the next word
+        run += left;
+        break;
+      }
+
+      run += n;
+      if(decodeRun(d, level, run)) {
+        packets++;
+        if(print) printPacket(job, d, i * 64 + 64 - left + n);
+      }
+      level ^= 1;
+      run = 0;
+      w <<= n;
+      left -= n;
+    }
+  }
+  return packets;
+}
+
+/**
+ * Worker thread: take captures from the job list until all are decoded
+ */
+static void *worker(void *) {
+  nexa_decoder_t decoder;
+  int j;
+
+  while((j = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED)) < num_jobs) {
+    job_t *job = &jobs[j];
+    if(job->capture.samples == 0) continue;
+
+    for(int pass = 0; pass < passes; pass++) {
+      // Every pass starts from a clean decoder; only print the packets once, the other passes are for timing
+      int print = !quiet && pass == 0;
+      decoder_init(&decoder);
+      if(words) {
+        job->packets += replayWords(job, &decoder, print);
+      } else if(edges) {
+        job->packets += replayEdges(job, &decoder, print);
+      } else {
+        job->packets += replaySamples(job, &decoder, print);
+      }
+    }
+  }
+  return NULL;
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Decode all jobs with a number of threads
+ * @return the time it took in s
+ */
+static double decodeJobs(int threads) {
+  pthread_t *tids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+  next_job = 0;
+  double start = now();
+  for(int t = 0; t < threads; t++) {
+    pthread_create(&tids[t], NULL, worker, NULL);
+  }
+  for(int t = 0; t < threads; t++) {
+    pthread_join(tids[t], NULL);
+  }
+  free(tids);
+  return now() - start;
+}
+
+/**
+ * Scaling: with t threads every capture is decoded t times, once per thread, so the work per thread stays the same
+ */
+static void scale(const job_t *captures, int count, int max_threads) {
+  double base = 0;
+
+  for(int t = 1; t <= max_threads; t++) {
+    unsigned long samples = 0, packets = 0;
+
+    num_jobs = count * t;
+    jobs = (job_t *)calloc(num_jobs, sizeof(job_t));
+    for(int j = 0; j < num_jobs; j++) jobs[j] = captures[j % count];
+    double elapsed = decodeJobs(t);
+    for(int j = 0; j < num_jobs; j++) {
+      samples += jobs[j].capture.samples * passes;
+      packets += jobs[j].packets;
+    }
+    free(jobs);
+
+    double rate = packets / elapsed;
+    if(t == 1) base = rate;
+    printf("threads=%d cores=%ld mode=%s samples=%lu packets=%lu seconds=%.3f msamples/s=%.1f packets/s=%.1f "
+           "speedup=%.2f\n", t, sysconf(_SC_NPROCESSORS_ONLN), words ? "words" : edges ? "edges" : "samples", samples,
+           packets, elapsed, samples / elapsed / 1e6, rate, rate / base);
+    fflush(stdout);
+  }
+}
+
+static int usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-a] [-r] [-s] [-A] [-T] [-e] [-w] [-q] [-n passes] [-j threads] [-S threads] <capture> [capture...]\n"
+                  "       %s [-e] [-w] [-n passes] [-S threads] -y bursts\n", prog, prog);
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  int ascii = 0, rle = 0, stream = 0, adc = 0, adaptive = 0, threads = 1, scaling = 0, bursts = 0;
+  unsigned long samples = 0, packets = 0, readings = 0;
+  double elapsed, slicing = 0;
+  int opt;
+
+  while((opt = getopt(argc, argv, "arsATewqn:j:S:y:")) != -1) {
+    switch(opt) {
+      case 'a': ascii = 1; break;
+      case 'r': rle = 1; break;
+      case 's': stream = 1; break;
+      case 'A': adc = 1; break;
+      case 'T': adc = 1; adaptive = 1; break;
+      case 'e': edges = 1; break;
+      case 'w': words = 1; break;
+      case 'q': quiet = 1; break;
+      case 'n': passes = atoi(optarg); break;
+      case 'j': threads = atoi(optarg); break;
+      case 'S': scaling = atoi(optarg); break;
+      case 'y': bursts = atoi(optarg); break;
+      default: return usage(argv[0]);
+    }
+  }
+  if((optind >= argc && !bursts) || passes < 1 || threads < 1 || scaling < 0 || bursts < 0) return usage(argv[0]);
+
+  if(bursts) {
+    num_jobs = 1;
+    jobs = (job_t *)calloc(1, sizeof(job_t));
+    jobs[0].name = "synth";
+    if(!synthesize(&jobs[0].capture, bursts)) {
+      fprintf(stderr, "synth: out of memory\n");
+      return 1;
+    }
+  }
+
+  // Load all captures up front so only the decoding is timed
+  if(!bursts) {
+    num_jobs = argc - optind;
+    jobs = (job_t *)calloc(num_jobs, sizeof(job_t));
+  }
+  names = num_jobs > 1;
+  for(int j = 0; j < num_jobs && !bursts; j++) {
+    job_t *job = &jobs[j];
+    job->name = argv[optind + j];
+
+    FILE *f = fopen(job->name, ascii || rle ? "r" : "rb");
+    if(!f) {
+      perror(job->name);
+      return 1;
+    }
+    int ok = rle ? loadRle(f, &job->capture) :
+             ascii ? loadAscii(f, &job->capture) :
+             stream ? loadStream(f, job->name, &job->capture) :
+             loadPacked(f, &job->capture);
+    if(ok && adc) {
+      // Slicing is timed on its own: on the board this runs in the ADC interrupt for every conversion
+      double t = now();
+      readings += job->capture.samples / 8;
+      ok = sliceAdc(&job->capture, adaptive);
+      slicing += now() - t;
+    }
+    if(!ok) {
+      fprintf(stderr, "%s: out of memory\n", job->name);
+      return 1;
+    }
+    fclose(f);
+  }
+
+  if(scaling) {
+    // The packets are not printed, only the throughput
+    job_t *captures = jobs;
+    int count = num_jobs;
+    quiet = 1;
+    scale(captures, count, scaling);
+    for(int j = 0; j < count; j++) free(captures[j].capture.data);
+    free(captures);
+    return 0;
+  }
+
+  // Each thread decodes whole captures with its own decoder context
+  elapsed = decodeJobs(threads);
+
+  for(int j = 0; j < num_jobs; j++) {
+    samples += jobs[j].capture.samples * passes;
+    packets += jobs[j].packets;
+    free(jobs[j].capture.data);
+  }
+  free(jobs);
+
+  printf("Samples: %lu (%.1f s of air time at %d us)\n", samples, (double)samples * RX_SAMPLE_INTERVAL_US / 1e6, RX_SAMPLE_INTERVAL_US);
+  printf("Packets: %lu\n", packets);
+  if(adc) {
+    printf("Slice time: %.3f s with %s thresholds, %.2f ns/reading\n",
+           slicing, adaptive ? "adaptive" : "fixed", slicing * 1e9 / readings);
+  }
+  printf("Decode time: %.3f s on %d thread(s), %.2f ns/sample, %.1f Msamples/s, %.1f packets/s\n",
+         elapsed, threads, elapsed * 1e9 / samples, samples / elapsed / 1e6, packets / elapsed);
+  return 0;
+}
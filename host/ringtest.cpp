@@ -0,0 +1,266 @@
+/**
+ * Ring test - the lock-free byte ring (ring.h) between the sampler interrupt and the main loop, at mismatched rates
+ *
+ * Every byte the producer tries to add is numbered; the ones which do not fit are counted as overruns, as the timer
+ * sampler does. The bytes the consumer takes must be exactly the ones which were added, in order, and every byte
+ * tried must be either taken, still waiting or an overrun. Two ways:
+ *   ticks    one thread; per tick the producer tries p bytes and the consumer takes up to c, ring_space() and
+ *            ring_count() are checked against the bytes in the ring after every step
+ *   threads  a producer and a consumer thread paced by the clock: the producer tries one byte every p ns (the
+ *            sampler interrupt), the consumer may take one every c ns (the main loop). Both sleep between their
+ *            wakeups and catch up with the clock when they wake, so the rates hold on a single core too.
+ *            ring_space() and ring_count() may only be stale towards the safe side (a push fails only when no space
+ *            was seen, a pop fails only when nothing was waiting)
+ *
+ * Each scenario also bounds what its rates must give: the overruns in permille of the bytes tried (a producer a
+ * third faster than the consumer loses about a third of them, a slower one none), and the underruns in permille of
+ * the consumer's turns (a turn which found the ring empty before its share was taken: a slower producer leaves
+ * many turns short, about every other one with the wakeups of the threads, a faster one keeps the ring full).
+ *
+ * One line per scenario with key=value pairs; exits with 1 on any mismatch or a count out of its bounds.
+ *
+ * Usage: ringtest [-n bytes] [-t ms]
+ *   -n  bytes of each tick scenario
+ *   -t  time of each thread scenario in ms, the producer rate gives the bytes
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../ring.h"
+
+typedef struct {
+  const char *name;
+  int threads;               // 0: ticks, 1: threads
+  long produce;              // Bytes tried per tick, or ns between two bytes
+  long consume;              // Bytes taken per tick, or ns between two bytes
+  int overruns_min, overruns_max;    // Overruns, permille of the bytes tried
+  int underruns_min, underruns_max;  // Short turns of the consumer, permille of its turns
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+  { "ticks-fast",     0, 3,     2,     300, 370, 0,   10   },
+  { "ticks-slow",     0, 2,     3,     0,   0,   990, 1000 },
+  { "ticks-bursts",   0, 100,   40,    550, 650, 0,   10   },
+  { "threads-fast",   1, 20000, 30000, 280, 390, 0,   100  },
+  { "threads-slow",   1, 30000, 20000, 0,   20,  300, 1000 },
+  { "threads-even",   1, 20000, 20000, 0,   50,  0,   200  },
+};
+#define SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+// Time between the wakeups of the threads, in ns; the consumer's differs so the two do not run in step
+#define PRODUCER_WAKE_NS 100000
+#define CONSUMER_WAKE_NS 150000
+
+typedef struct {
+  ring_t ring;
+  unsigned long bytes;       // Bytes to try
+  long produce, consume;     // ns between two bytes
+  uint32_t *added;           // Numbers of the bytes added, in order
+  unsigned long nadded;
+  unsigned long overruns;
+  uint8_t *taken;            // Bytes taken, in order
+  unsigned long ntaken;
+  unsigned long turns;       // Turns of the consumer with a share of at least one byte
+  unsigned long underruns;   // Turns which found the ring empty before their share was taken
+  volatile int done;         // Set by the producer after its last byte
+  unsigned long perrors;     // Counter checks failed on the producer side
+  unsigned long cerrors;     // Counter checks failed on the consumer side
+} test_t;
+
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_until(long long ns) {
+  struct timespec ts = { (time_t)(ns / 1000000000LL), (long)(ns % 1000000000LL) };
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) {}
+}
+
+/**
+ * Try to add the next byte, as the sampler interrupt does
+ */
+static void produce(test_t *t, unsigned long i, int stale_ok) {
+  uint8_t space = ring_space(&t->ring);
+  if(ring_push(&t->ring, (uint8_t)i)) {
+    // The consumer only makes room, so space seen is never more than there was
+    if(!stale_ok && space == 0) t->perrors++;
+    t->added[t->nadded++] = i;
+  } else {
+    if(space != 0) t->perrors++;
+    t->overruns++;
+  }
+}
+
+/**
+ * Take the next byte
+ * @return 0 when the ring was empty
+ */
+static int consume(test_t *t, int stale_ok) {
+  uint8_t count = ring_count(&t->ring), val;
+  if(ring_pop(&t->ring, &val)) {
+    // The producer only adds, so the count seen is never more than there is
+    if(!stale_ok && count == 0) t->cerrors++;
+    t->taken[t->ntaken++] = val;
+    return 1;
+  }
+  if(count != 0) t->cerrors++;
+  return 0;
+}
+
+/**
+ * Producer thread: every wakeup, try the bytes which are due by the clock
+ */
+static void *producer(void *arg) {
+  test_t *t = (test_t *)arg;
+  long long start = now_ns(), wake = start;
+  unsigned long i = 0;
+
+  while(i < t->bytes) {
+    unsigned long due = (now_ns() - start) / t->produce;
+    for(; i < due && i < t->bytes; i++) produce(t, i, 1);
+    wake += PRODUCER_WAKE_NS;
+    sleep_until(wake);
+  }
+  __atomic_store_n(&t->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/**
+ * Consumer thread: every wakeup, take as many bytes as the time since the last one allows; time spent with the
+ * ring empty is not made up later
+ */
+static void *consumer(void *arg) {
+  test_t *t = (test_t *)arg;
+  long long last = now_ns(), wake = last, credit = 0;
+
+  while(1) {
+    int done = __atomic_load_n(&t->done, __ATOMIC_ACQUIRE);
+    long long now = now_ns();
+    credit += now - last;
+    last = now;
+
+    long n = credit / t->consume;
+    credit -= n * t->consume;
+    // A turn right after a late one may have no share yet, it does not count
+    if(n) t->turns++;
+    for(; n; n--) {
+      if(!consume(t, 1)) break;
+    }
+    if(n) {
+      // Found the ring empty before the share of this turn was taken
+      if(done) break;
+      t->underruns++;
+      credit = 0;
+    }
+
+    wake += CONSUMER_WAKE_NS;
+    sleep_until(wake);
+  }
+  return NULL;
+}
+
+/**
+ * Both sides in one thread, tick by tick, the counters checked after every step
+ */
+static void ticks(test_t *t, int produce_n, int consume_n) {
+  unsigned long i = 0;
+  while(i < t->bytes || ring_count(&t->ring)) {
+    for(int k = 0; k < produce_n && i < t->bytes; k++, i++) {
+      produce(t, i, 0);
+      unsigned long waiting = t->nadded - t->ntaken;
+      if(ring_count(&t->ring) != waiting || ring_space(&t->ring) != RING_SIZE - 1 - waiting) t->perrors++;
+    }
+    // The last ticks only drain what is left, they are not turns at the rate
+    if(i == t->bytes) {
+      while(consume(t, 0)) {}
+      break;
+    }
+    int k = 0;
+    for(; k < consume_n; k++) {
+      if(!consume(t, 0)) break;
+      unsigned long waiting = t->nadded - t->ntaken;
+      if(ring_count(&t->ring) != waiting || ring_space(&t->ring) != RING_SIZE - 1 - waiting) t->perrors++;
+    }
+    if(k < consume_n) t->underruns++;
+    t->turns++;
+  }
+}
+
+static int run(const scenario_t *sc, unsigned long bytes, long ms) {
+  test_t *t = (test_t *)calloc(1, sizeof(test_t));
+  // Paced scenarios run for a fixed time, the producer rate gives the bytes
+  if(sc->threads) bytes = ms * 1000000L / sc->produce;
+  t->bytes = bytes;
+  t->produce = sc->produce;
+  t->consume = sc->consume;
+  t->added = (uint32_t *)malloc(bytes * sizeof(uint32_t));
+  t->taken = (uint8_t *)malloc(bytes);
+  ring_init(&t->ring);
+
+  if(sc->threads) {
+    pthread_t p, c;
+    pthread_create(&c, NULL, consumer, t);
+    pthread_create(&p, NULL, producer, t);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+  } else {
+    ticks(t, sc->produce, sc->consume);
+  }
+
+  // Every byte taken in the order it was added, none twice, none made up
+  unsigned long order = 0;
+  for(unsigned long i = 0; i < t->ntaken; i++) {
+    if(i >= t->nadded || t->taken[i] != (uint8_t)t->added[i]) order++;
+  }
+
+  // The ring is empty at the end: every byte tried was taken or counted as an overrun
+  unsigned long waiting = ring_count(&t->ring);
+  int sums = t->nadded + t->overruns == bytes && t->ntaken + waiting == t->nadded && waiting == 0 &&
+             ring_space(&t->ring) == RING_SIZE - 1;
+
+  // The rates show in the counts
+  unsigned long over = bytes ? t->overruns * 1000 / bytes : 0;
+  unsigned long under = t->turns ? t->underruns * 1000 / t->turns : 0;
+  int rates = over >= (unsigned long)sc->overruns_min && over <= (unsigned long)sc->overruns_max &&
+              under >= (unsigned long)sc->underruns_min && under <= (unsigned long)sc->underruns_max;
+
+  unsigned long errors = t->perrors + t->cerrors;
+  int ok = !order && !errors && sums && rates;
+  printf("scenario=%s ring=%d bytes=%lu added=%lu overruns=%lu taken=%lu waiting=%lu turns=%lu underruns=%lu "
+         "overruns_permille=%lu(%d-%d) underruns_permille=%lu(%d-%d) order_errors=%lu counter_errors=%lu sums=%s "
+         "rates=%s result=%s\n", sc->name, RING_SIZE, bytes, t->nadded, t->overruns, t->ntaken, waiting, t->turns,
+         t->underruns, over, sc->overruns_min, sc->overruns_max, under, sc->underruns_min, sc->underruns_max, order,
+         errors, sums ? "ok" : "wrong", rates ? "ok" : "wrong", ok ? "ok" : "FAIL");
+  fflush(stdout);
+
+  free(t->added);
+  free(t->taken);
+  free(t);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  unsigned long bytes = 1000000;
+  long ms = 500;
+  int opt, ok = 1;
+
+  while((opt = getopt(argc, argv, "n:t:")) != -1) {
+    switch(opt) {
+      case 'n': bytes = strtoul(optarg, NULL, 0); break;
+      case 't': ms = atol(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-n bytes] [-t ms]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  for(unsigned i = 0; i < SCENARIOS; i++) ok &= run(&scenarios[i], bytes, ms);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/**
+ * Sample interval sweep - decode yield and cost of the decoder at the interval it was compiled for
+ *
+ * The pulse windows are derived from RX_SAMPLE_INTERVAL_US at compile time, so this program is built once per
+ * interval (see 'make sweep'), with or without clock recovery (see 'make skew'). It synthesizes bursts of repeated
+ * frames with random packets, samples them at the compiled interval and reports how many bursts were decoded and
+ * what the decoding costs per sample. With -k every burst comes from a transmitter whose clock is off by a random
+ * amount of up to the given percentage.
+ *
+ * Usage: sweep [-b bursts] [-r repeats] [-j jitter_us] [-k skew_percent] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../config.h"
+#include "../decoder_full.h"
+#include "synth.h"
+
+// Silence between bursts, in us - long enough for the debouncer to forget the previous packet
+#define BURST_GAP_US 300000
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+int main(int argc, char **argv) {
+  int bursts = 1000, repeats = 5, skew = 0, opt;
+  long jitter = 25;
+  uint32_t rng = 12345;
+
+  while((opt = getopt(argc, argv, "b:r:j:k:s:")) != -1) {
+    switch(opt) {
+      case 'b': bursts = atoi(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      case 'j': jitter = atol(optarg); break;
+      case 'k': skew = atoi(optarg); break;
+      case 's': rng = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-b bursts] [-r repeats] [-j jitter_us] [-k skew_percent] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  // Synthesize all bursts first so only the decoding is timed; remember where each burst starts
+  synth_signal_t sig = { NULL, 0, 0 };
+  uint32_t *sent = (uint32_t *)malloc(bursts * sizeof(uint32_t));
+  unsigned long *start = (unsigned long *)malloc((bursts + 1) * sizeof(unsigned long));
+
+  for(int b = 0; b < bursts; b++) {
+    synth_train_t train = { NULL, 0, 0 };
+    int k = synth_jitter(&rng, skew);
+    sent[b] = synth_rand(&rng);
+    for(int r = 0; r < repeats; r++) synth_frame(&train, sent[b], k);
+    synth_pulse(&train, 0, BURST_GAP_US);
+
+    start[b] = sig.count;
+    synth_sample(&sig, &train, RX_SAMPLE_INTERVAL_US, jitter, &rng);
+    free(train.pulses);
+  }
+  start[bursts] = sig.count;
+
+  // Decode, checking each packet against the burst it was found in
+  nexa_decoder_t decoder;
+  unsigned long good = 0, bad = 0;
+  int b = 0;
+
+  decoder_init(&decoder);
+  double t = now();
+  uint64_t c = cycles();
+  for(unsigned long i = 0; i < sig.count; i++) {
+    if(decodeSample(&decoder, sig.samples[i])) {
+      while(i >= start[b + 1]) b++;
+      if(lastPacket(&decoder) == sent[b]) good++; else bad++;
+    }
+  }
+  c = cycles() - c;
+  t = now() - t;
+
+  printf("interval_us=%d clock=%s windows=%d/%d/%d/%d fuzzy=%d/%d bursts=%d skew=%d%% yield=%.1f%% false=%lu ns/sample=%.2f cycles/sample=%.1f\n",
+         RX_SAMPLE_INTERVAL_US, CLOCK_RECOVERY ? "recovered" : "fixed",
+         SHORT_HIGH_PULSE_SAMPLES, SHORT_LOW_PULSE_SAMPLES, LONG_PULSE_SAMPLES, START_PULSE_SAMPLES,
+         FUZZY_SAMPLES_SHORT, FUZZY_SAMPLES_LONG,
+         bursts, skew, 100.0 * good / bursts, bad, t * 1e9 / sig.count, (double)c / sig.count);
+
+  free(sig.samples);
+  free(sent);
+  free(start);
+  return 0;
+}
@@ -0,0 +1,277 @@
+/**
+ * Signal synthesizer - generates Nexa transmissions as the receiver would output them
+ *
+ * A transmission is built as a pulse train (alternating levels with a width in us) using the receiver pulse
+ * widths from protocol.h, then sampled at the decoder sample interval with a random phase and edge jitter.
+ * The channel model works on both: a weak signal shortens the high pulses of the train, bit flips and noise
+ * bursts corrupt the samples, a weak receiver outputs noise in long lows once its gain control has turned up the gain,
+ * and a second transmitter keyed at the same time is mixed into the samples.
+ * For the analog front end the train is sampled at the ADC conversion rate and the levels become readings.
+ * synth_source samples a train on the fly as the source of a receiver (receiver.h).
+ */
+
+#ifndef _SYNTH_H_
+#define _SYNTH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../protocol.h"
+
+// Pause after each repeat of a frame, in us
+#define SYNTH_REPEAT_PAUSE_US 10000
+
+// One pulse of a pulse train
+typedef struct {
+  uint8_t  level;
+  uint32_t us;
+} synth_pulse_t;
+
+// Growing pulse train
+typedef struct {
+  synth_pulse_t *pulses;
+  unsigned long count;
+  unsigned long cap;
+} synth_train_t;
+
+// Pause after which the gain control of a weak receiver has turned the gain up far enough to output noise, in us;
+// longer than a long low, so only the SYNC and the pauses between frames get it
+#define SYNTH_AGC_US 1300
+
+// Channel impairments applied to the samples
+typedef struct {
+  uint32_t flip_ppm;      // Probability of a flipped sample, per million samples
+  uint32_t noise_per_s;   // Noise bursts per second of signal
+  uint32_t noise_us;      // Longest noise burst, in us; the samples of a burst are random
+  uint32_t agc_ppm;       // Probability of a noise sample in a low longer than SYNTH_AGC_US, per million samples
+} synth_channel_t;
+
+// Analog receiver output, on the 8 bit scale of the ADC readings
+typedef struct {
+  uint8_t low;            // Reading at a low level
+  uint8_t high;           // Reading at a high level
+  uint8_t noise;          // Noise on every reading, up to this many steps either way (triangular)
+  uint32_t spike_ppm;     // Probability of a reading replaced by a random value, per million readings
+} synth_analog_t;
+
+// Sampled signal: one sample per byte
+typedef struct {
+  uint8_t *samples;
+  unsigned long count;
+  unsigned long cap;
+} synth_signal_t;
+
+/**
+ * Small deterministic random generator (xorshift32) so runs can be repeated
+ */
+static inline uint32_t synth_rand(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+/**
+ * Uniform random value in [-range, range]
+ */
+static inline long synth_jitter(uint32_t *state, long range) {
+  if(range <= 0) return 0;
+  return (long)(synth_rand(state) % (2 * range + 1)) - range;
+}
+
+/**
+ * Append a pulse, merging it with the previous one when the level is the same
+ */
+static inline void synth_pulse(synth_train_t *t, uint8_t level, uint32_t us) {
+  if(t->count > 0 && t->pulses[t->count - 1].level == level) {
+    t->pulses[t->count - 1].us += us;
+    return;
+  }
+  if(t->count == t->cap) {
+    t->cap = t->cap ? t->cap * 2 : 1024;
+    t->pulses = (synth_pulse_t *)realloc(t->pulses, t->cap * sizeof(synth_pulse_t));
+  }
+  t->pulses[t->count].level = level;
+  t->pulses[t->count].us = us;
+  t->count++;
+}
+
+/**
+ * Append one frame of any length: SYNC, the symbols (MSB first) and the final high pulse followed by the repeat
+ * pause. Symbol number dim (counted from the first, -1 for none) is sent as the dim symbol of the Nexa dimmer.
+ * All widths are scaled by (100 + skew) percent to model a transmitter with a fast or slow clock.
+ */
+static inline void synth_frame_bits(synth_train_t *t, uint64_t raw, uint8_t bits, int dim, int skew) {
+  uint32_t high   = RX_SHORT_HIGH_US * (100 + skew) / 100;
+  uint32_t lshort = RX_SHORT_LOW_US * (100 + skew) / 100;
+  uint32_t llong  = RX_LONG_LOW_US * (100 + skew) / 100;
+
+  synth_pulse(t, 1, high);
+  synth_pulse(t, 0, RX_START_LOW_US * (100 + skew) / 100);
+
+  for(int i = 0; i < bits; i++) {
+    // 1 = hLhl, 0 = hlhL, dim = hlhl
+    uint8_t bit = (raw >> (bits - 1 - i)) & 0x1;
+    synth_pulse(t, 1, high);
+    synth_pulse(t, 0, i != dim && bit ? llong : lshort);
+    synth_pulse(t, 1, high);
+    synth_pulse(t, 0, i != dim && !bit ? llong : lshort);
+  }
+
+  synth_pulse(t, 1, high);
+  synth_pulse(t, 0, SYNTH_REPEAT_PAUSE_US * (100 + skew) / 100);
+}
+
+/**
+ * Append one Nexa frame: SYNC, 32 data bits (MSB first) and the final high pulse followed by the repeat pause
+ */
+static inline void synth_frame(synth_train_t *t, uint32_t raw, int skew) {
+  synth_frame_bits(t, raw, 32, -1, skew);
+}
+
+/**
+ * Sample a pulse train at interval_us, starting at a random phase within the first sample. Every edge is moved
+ * by up to jitter_us to model a noisy receiver.
+ */
+static inline void synth_sample(synth_signal_t *s, const synth_train_t *t, uint32_t interval_us, long jitter_us, uint32_t *rng) {
+  // Time is tracked in us, the next sample is taken at 'next'
+  long next = synth_rand(rng) % interval_us;
+  long edge = 0;
+
+  for(unsigned long p = 0; p < t->count; p++) {
+    // The last edge is not moved so the train keeps its total length
+    edge += t->pulses[p].us;
+    long end = edge + (p + 1 < t->count ? synth_jitter(rng, jitter_us) : 0);
+
+    while(next < end) {
+      if(s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 65536;
+        s->samples = (uint8_t *)realloc(s->samples, s->cap);
+      }
+      s->samples[s->count++] = t->pulses[p].level;
+      next += interval_us;
+    }
+  }
+}
+
+/**
+ * Sample source for a receiver (receiver.h): samples a pulse train as it is read, the same samples synth_sample()
+ * makes from the same random state, without a buffer
+ */
+struct synth_source {
+  const synth_train_t *train;
+  uint32_t interval_us;
+  long jitter_us;
+  uint32_t *rng;
+  unsigned long pulse;    // Pulse of the next sample
+  long next;              // Time of the next sample, in us
+  long edge;              // End of the pulse without the jitter
+  long end;               // End of the pulse
+
+  void begin() {
+    next = synth_rand(rng) % interval_us;
+    edge = 0;
+    pulse = 0;
+    enter();
+  }
+  uint8_t available() { return pulse < train->count; }
+  uint8_t read() {
+    uint8_t level = train->pulses[pulse].level;
+    next += interval_us;
+    if(next >= end) {
+      pulse++;
+      enter();
+    }
+    return level;
+  }
+
+  // Move on to the first pulse from 'pulse' on which holds the next sample, jittering every edge on the way
+  void enter() {
+    for(; pulse < train->count; pulse++) {
+      edge += train->pulses[pulse].us;
+      end = edge + (pulse + 1 < train->count ? synth_jitter(rng, jitter_us) : 0);
+      if(next < end) return;
+    }
+  }
+};
+
+/**
+ * Model a weak signal: the receiver outputs shorter high pulses and longer low pulses, the period stays the same
+ */
+static inline void synth_attenuate(synth_train_t *t, uint32_t us) {
+  for(unsigned long p = 0; p + 1 < t->count; p++) {
+    if(!t->pulses[p].level) continue;
+    uint32_t cut = MIN(us, t->pulses[p].us);
+    t->pulses[p].us -= cut;
+    t->pulses[p + 1].us += cut;
+  }
+}
+
+/**
+ * Corrupt the samples from index 'from' on with the channel impairments
+ */
+static inline void synth_corrupt(synth_signal_t *s, unsigned long from, const synth_channel_t *ch, uint32_t *rng) {
+  if(ch->agc_ppm) {
+    // Counted before any other impairment: a noise sample does not end the low for the gain control
+    unsigned long zeroes = 0;
+    for(unsigned long i = from; i < s->count; i++) {
+      if(s->samples[i]) {
+        zeroes = 0;
+      } else if(++zeroes * RX_SAMPLE_INTERVAL_US > SYNTH_AGC_US && synth_rand(rng) % 1000000 < ch->agc_ppm) {
+        s->samples[i] = 1;
+      }
+    }
+  }
+
+  if(ch->flip_ppm) {
+    for(unsigned long i = from; i < s->count; i++) {
+      if(synth_rand(rng) % 1000000 < ch->flip_ppm) s->samples[i] ^= 1;
+    }
+  }
+
+  if(ch->noise_per_s && ch->noise_us) {
+    // Expected number of bursts over the length of the signal, the fraction decides on one more
+    uint64_t us = (uint64_t)(s->count - from) * RX_SAMPLE_INTERVAL_US;
+    uint64_t expected = us * ch->noise_per_s;
+    unsigned long bursts = expected / 1000000 + (synth_rand(rng) % 1000000 < expected % 1000000);
+
+    for(unsigned long b = 0; b < bursts; b++) {
+      unsigned long at = from + synth_rand(rng) % (s->count - from);
+      unsigned long len = (synth_rand(rng) % ch->noise_us) / RX_SAMPLE_INTERVAL_US + 1;
+      for(unsigned long i = at; i < at + len && i < s->count; i++) s->samples[i] = synth_rand(rng) & 0x1;
+    }
+  }
+}
+
+/**
+ * Turn the levels from index 'from' on into ADC readings of an analog receiver: the low or high reading plus noise,
+ * and now and then a spike to a random value
+ */
+static inline void synth_analog(synth_signal_t *s, unsigned long from, const synth_analog_t *a, uint32_t *rng) {
+  for(unsigned long i = from; i < s->count; i++) {
+    long val = s->samples[i] ? a->high : a->low;
+    if(a->noise) val += (synth_jitter(rng, a->noise) + synth_jitter(rng, a->noise)) / 2;
+    if(a->spike_ppm && synth_rand(rng) % 1000000 < a->spike_ppm) val = synth_rand(rng) & 0xFF;
+    s->samples[i] = val < 0 ? 0 : val > 255 ? 255 : val;
+  }
+}
+
+/**
+ * Mix a second transmitter into the samples, starting at index 'at': the receiver outputs a high when either is
+ * keyed. The signal grows when the other one ends later.
+ */
+static inline void synth_mix(synth_signal_t *s, unsigned long at, const synth_signal_t *other) {
+  for(unsigned long i = 0; i < other->count; i++) {
+    if(at + i == s->count) {
+      if(s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 65536;
+        s->samples = (uint8_t *)realloc(s->samples, s->cap);
+      }
+      s->samples[s->count++] = 0;
+    }
+    s->samples[at + i] |= other->samples[i];
+  }
+}
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * Event trace parser - reads the binary trace of the debug decoder (DEBUG_TRACE, see trace.h)
+ *
+ * Bytes are pushed one at a time and come out as records. A byte which starts a record cuts off the record before
+ * it if that one is incomplete (bytes were lost); bytes outside of any record are text, like the banner the sketch
+ * prints before the trace starts and the timing reports.
+ */
+
+#ifndef _TRACE_PARSER_H_
+#define _TRACE_PARSER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../trace.h"
+
+// Record types
+#define TRACE_RECORD_PULSE   0
+#define TRACE_RECORD_TIME    1
+#define TRACE_RECORD_DROPPED 2
+
+// Result of pushing a byte
+#define TRACE_PARSE_NONE   0     // Part of a record
+#define TRACE_PARSE_RECORD 1     // A record is complete
+#define TRACE_PARSE_TEXT   2     // Not part of a record
+
+typedef struct {
+  uint8_t type;
+  uint8_t level;         // Pulse level
+  uint8_t event;         // Event of the pulse
+  uint32_t value;        // Length of the pulse, samples taken or samples lost
+} trace_record_t;
+
+typedef struct {
+  uint8_t buf[TRACE_RECORD_MAX];
+  uint8_t len;
+  uint8_t size;                // Size of the record in buf, 0 between records
+  unsigned long records;       // Complete records
+  unsigned long broken;        // Records cut off by the next one
+} trace_parser_t;
+
+static inline void trace_parser_init(trace_parser_t *p) {
+  memset(p, 0, sizeof(*p));
+}
+
+/**
+ * Push one byte of the stream
+ * @return TRACE_PARSE_RECORD when a record is complete (in *out), TRACE_PARSE_TEXT for a byte outside of records
+ */
+static inline uint8_t trace_parser_push(trace_parser_t *p, uint8_t byte, trace_record_t *out) {
+  uint8_t size = trace_record_size(byte);
+
+  if(size) {
+    if(p->size) p->broken++;
+    p->size = size;
+    p->len = 0;
+  } else if(!p->size) {
+    return TRACE_PARSE_TEXT;
+  }
+
+  p->buf[p->len++] = byte;
+  if(p->len < p->size) return TRACE_PARSE_NONE;
+
+  uint8_t first = p->buf[0];
+  if(first == TRACE_TIME) {
+    out->type = TRACE_RECORD_TIME;
+    out->value = trace_get7(p->buf + 1, 4);
+  } else if(first == TRACE_DROPPED) {
+    out->type = TRACE_RECORD_DROPPED;
+    out->value = trace_get7(p->buf + 1, 3);
+  } else {
+    out->type = TRACE_RECORD_PULSE;
+    out->level = (first >> 6) & 0x1;
+    out->event = (first >> 2) & 0xF;
+    out->value = trace_get7(p->buf + 1, p->size - 1);
+  }
+  p->size = 0;
+  p->records++;
+  return TRACE_PARSE_RECORD;
+}
+
+#endif
@@ -0,0 +1,333 @@
+/**
+ * Trace viewer - shows the binary event trace of the debug decoder (DEBUG_TRACE in decoder_debug.h, see trace.h)
+ *
+ * Reads a capture of the serial port (or stdin) and prints every frame the board saw, from its SYNC to its PAUSE,
+ * with the event characters of the debug printout (S sync, h short high, l short low, L long low, _ pause,
+ * X invalid, and . for a pulse the detector ignored), followed by what the frame decodes to: the packet, or the
+ * symbol where it fails with the widths of its pulses. The pulse widths also rebuild the sample stream, which -d
+ * feeds to the full decoder to compare its packets with the frames. Text between the records (the banner, timing
+ * reports) is printed as it comes, lost records and bytes are reported where they happened.
+ *
+ * With -c it turns a packed sample capture (as read by replay) into a trace the way the board makes it.
+ *
+ * Usage: tracedump [-a] [-d] [file]
+ *        tracedump -c capture > trace
+ *   -a  also print the pulses between frames
+ *   -d  decode the rebuilt sample stream with the full decoder as well
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../config.h"
+#include "../decoder_full.h"
+#include "../decoder_debug.h"
+#include "trace_parser.h"
+
+// Pulses of a frame kept at most; a frame has 1 + 32 * 4 + 2 events plus whatever glitches it picked up
+#define FRAME_PULSES 512
+
+// Pulses printed per line between frames
+#define NOISE_LINE 100
+
+// A pulse of the trace
+typedef struct {
+  uint8_t event;
+  uint32_t width;
+} pulse_t;
+
+static int all = 0, decode = 0;
+
+// Frame being collected, from its SYNC
+static pulse_t frame[FRAME_PULSES];
+static int frame_len = 0;
+static uint64_t frame_start;
+
+// Pulses between frames, with -a
+static char noise[NOISE_LINE + 1];
+static int noise_len = 0;
+static uint64_t noise_start;
+
+// Text between the records
+static char text[256];
+static int text_len = 0;
+
+static unsigned long frames = 0, packets = 0, decoded = 0, lost = 0;
+
+static double seconds(uint64_t samples) {
+  return (double)samples * RX_SAMPLE_INTERVAL_US / 1e6;
+}
+
+static char eventChar(uint8_t event) {
+  switch(event) {
+    case EVENT_NONE:       return '.';
+    case EVENT_INVALID:    return 'X';
+    case EVENT_HIGH_SHORT: return 'h';
+    case EVENT_LOW_SHORT:  return 'l';
+    case EVENT_LOW_LONG:   return 'L';
+    case EVENT_SYNC:       return 'S';
+    case EVENT_PAUSE:      return '_';
+  }
+  return '?';
+}
+
+static void printPacket(const char *what, uint32_t raw) {
+  nexa_pckt_t *p = (nexa_pckt_t *)&raw;
+  printf("%s %X:%X group:%X channel: %X on:%X\n", what, p->device_id, p->unit, p->group, p->channel, p->on_off);
+}
+
+/**
+ * Print the pulses between frames collected so far
+ */
+static void flushNoise() {
+  if(!noise_len) return;
+  noise[noise_len] = 0;
+  printf("%12.6f s  %s\n", seconds(noise_start), noise);
+  noise_len = 0;
+}
+
+/**
+ * Decode the events of a frame like the frame decoder does and print the result. The glitches the detector ignored
+ * are skipped, as they are by the frame decoder.
+ */
+static void analyze(const char *end) {
+  uint8_t events[FRAME_PULSES];
+  int index[FRAME_PULSES];
+  int n = 0;
+
+  for(int i = 1; i < frame_len; i++) {
+    if(frame[i].event == EVENT_NONE) continue;
+    index[n] = i;
+    events[n++] = frame[i].event;
+  }
+
+  uint32_t raw = 0;
+  int i = 0;
+  for(uint8_t k = 0; k < nexa_protocol::bits; k++, i += 4) {
+    if(n - i < 4 || events[i + 3] == EVENT_PAUSE) {
+      printf("                incomplete: %u symbols%s\n", k, end);
+      return;
+    }
+
+    uint8_t value = SYMBOL_INVALID;
+    if(events[i] == EVENT_HIGH_SHORT && (events[i + 1] == EVENT_LOW_SHORT || events[i + 1] == EVENT_LOW_LONG) &&
+       events[i + 2] == EVENT_HIGH_SHORT && (events[i + 3] == EVENT_LOW_SHORT || events[i + 3] == EVENT_LOW_LONG)) {
+      value = nexa_protocol::symbol(((events[i + 1] == EVENT_LOW_LONG) << 1) | (events[i + 3] == EVENT_LOW_LONG), k);
+    }
+
+    if(value == SYMBOL_INVALID) {
+      // The pulses of the symbol, glitches included, with their widths in samples
+      printf("                invalid symbol %u at pulse %d:", k, index[i]);
+      int last = MIN(index[MIN(i + 3, n - 1)], frame_len - 1);
+      for(int j = index[i]; j <= last; j++) printf(" %c%u", eventChar(frame[j].event), frame[j].width);
+      printf("%s\n", end);
+      return;
+    }
+    raw = (raw << 1) | value;
+  }
+
+  if(events[n - 1] != EVENT_PAUSE) {
+    printf("                no pause after the last symbol%s\n", end);
+    return;
+  }
+
+  // A frame ends with the high of the pause bit, but the frame decoder takes up to 3 events before the pause
+  int extra = n - 1 - i;
+  for(int j = i; j < n - 1; j++) {
+    if(events[j] == EVENT_INVALID) extra = 4;
+  }
+  if(extra >= 4) {
+    printf("                %d events after the last symbol\n", n - 1 - i);
+    return;
+  }
+  packets++;
+  printPacket("                packet", raw);
+}
+
+/**
+ * Print the frame collected so far
+ * @param end why the frame ended, when it was not its PAUSE
+ */
+static void flushFrame(const char *end) {
+  if(!frame_len) return;
+
+  printf("%12.6f s  ", seconds(frame_start));
+  for(int i = 0; i < frame_len; i++) putchar(eventChar(frame[i].event));
+  putchar('\n');
+  frames++;
+  analyze(end);
+  frame_len = 0;
+}
+
+/**
+ * Process a pulse of the trace
+ */
+static void pulse(uint8_t event, uint32_t width, uint64_t start) {
+  if(event == EVENT_SYNC) {
+    flushNoise();
+    flushFrame(", cut off by the next SYNC");
+    frame_start = start;
+  }
+
+  if(frame_len || event == EVENT_SYNC) {
+    if(frame_len == FRAME_PULSES) {
+      flushFrame(", too long");
+    } else {
+      frame[frame_len].event = event;
+      frame[frame_len++].width = width;
+      if(event == EVENT_PAUSE) flushFrame("");
+    }
+    return;
+  }
+
+  if(all) {
+    if(!noise_len) noise_start = start;
+    noise[noise_len++] = eventChar(event);
+    if(noise_len == NOISE_LINE) flushNoise();
+  }
+}
+
+/**
+ * Something was lost at this point of the trace
+ */
+static void gap(const char *what, uint64_t at, uint64_t samples) {
+  flushNoise();
+  flushFrame(", cut off by lost records");
+  printf("%12.6f s  -- %s", seconds(at), what);
+  if(samples) printf(", %.6f s", seconds(samples));
+  putchar('\n');
+}
+
+/**
+ * Make a trace from a packed capture like the board does: every pulse becomes a record, every
+ * DEBUG_TRACE_TIME_RECORDS records a time record goes before it. Nothing gets lost here.
+ */
+static int convert(const char *name) {
+  FILE *f = fopen(name, "rb");
+  if(!f) {
+    perror(name);
+    return 1;
+  }
+
+  pulse_detector_t detector;
+  trace_pulse_t p;
+  uint8_t rec[TRACE_RECORD_MAX], buf[TRACE_RECORD_MAX];
+  uint32_t traced = 0;
+  int records = 0, c;
+
+  detector_init(&detector);
+  trace_init(&p);
+  printf("Nexa RF - debug module\r\n");
+
+  while((c = fgetc(f)) != EOF) {
+    for(int8_t i = 7; i >= 0; i--) {
+      uint8_t val = (c >> i) & 0x1;
+      uint8_t size = trace_sample(&p, val, detectPulse(&detector, val), rec);
+      if(!size) continue;
+
+      if(++records == DEBUG_TRACE_TIME_RECORDS) {
+        records = 0;
+        fwrite(buf, 1, trace_put_time(buf, traced), stdout);
+      }
+      fwrite(rec, 1, size, stdout);
+      traced += p.ended;
+    }
+  }
+
+  fclose(f);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int opt;
+
+  while((opt = getopt(argc, argv, "adc:")) != -1) {
+    switch(opt) {
+      case 'a': all = 1; break;
+      case 'd': decode = 1; break;
+      case 'c': return convert(optarg);
+      default:
+        fprintf(stderr, "Usage: %s [-a] [-d] [file]\n       %s -c capture > trace\n", argv[0], argv[0]);
+        return 2;
+    }
+  }
+
+  FILE *f = stdin;
+  if(optind < argc && !(f = fopen(argv[optind], "rb"))) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  trace_parser_t parser;
+  trace_record_t r;
+  nexa_decoder_t decoder;
+  uint64_t clock = 0;          // Samples before the next record
+  unsigned long broken = 0;
+  int c;
+
+  trace_parser_init(&parser);
+  decoder_init(&decoder);
+
+  while((c = fgetc(f)) != EOF) {
+    uint8_t res = trace_parser_push(&parser, c, &r);
+
+    if(parser.broken != broken) {
+      broken = parser.broken;
+      gap("bytes lost, record cut off", clock, 0);
+    }
+
+    if(res == TRACE_PARSE_TEXT) {
+      // Text lines as they come, without the carriage returns
+      if(c == '\n' || text_len == (int)sizeof(text) - 1) {
+        flushNoise();
+        text[text_len] = 0;
+        printf("# %s\n", text);
+        text_len = 0;
+      } else if(c != '\r') {
+        text[text_len++] = c;
+      }
+      continue;
+    }
+    if(res != TRACE_PARSE_RECORD) continue;
+
+    switch(r.type) {
+      case TRACE_RECORD_PULSE:
+        pulse(r.event, r.value, clock);
+        clock += r.value;
+        if(decode && decodeRun(&decoder, r.level, r.value)) {
+          decoded++;
+          printf("%12.6f s  ", seconds(clock));
+          printPacket("decoder:", lastPacket(&decoder));
+        }
+        break;
+      case TRACE_RECORD_TIME:
+        // The time only wraps after hours; a difference means the stream started late or bytes were lost
+        if(r.value != (clock & 0xFFFFFFF)) {
+          uint64_t now = (clock & ~(uint64_t)0xFFFFFFF) | r.value;
+          if(now < clock) now += 1UL << 28;
+          gap("time skips ahead", clock, now - clock);
+          clock = now;
+        }
+        break;
+      case TRACE_RECORD_DROPPED:
+        // The board lost these while its ring was full; to the decoder they are silence
+        gap("records lost on the board", clock, r.value);
+        lost += r.value;
+        if(decode) decodeRun(&decoder, 0, r.value);
+        clock += r.value;
+        break;
+    }
+  }
+
+  flushNoise();
+  flushFrame(", end of the trace");
+
+  fprintf(stderr, "records=%lu broken=%lu samples=%llu frames=%lu packets=%lu", parser.records, parser.broken,
+          (unsigned long long)clock, frames, packets);
+  if(decode) fprintf(stderr, " decoded=%lu", decoded);
+  fprintf(stderr, " lost_samples=%lu\n", lost);
+
+  if(f != stdin) fclose(f);
+  return 0;
+}
@@ -0,0 +1,195 @@
+#include "output.h"
+// Packet layout
+#include "protocols.h"
+// Binary frames
+#include "packet_frame.h"
+// Load the project config
+#include "config.h"
+
+// Only implement the functions for the full decoder
+#if ENABLE_FULL_DECODER && defined(ARDUINO)
+
+// Queued packet
+typedef struct {
+  uint32_t raw;
+  uint32_t time_ms;      // millis() at the first frame
+  uint8_t repeats;       // Frames received so far
+} queued_t;
+
+// Queue of packets: only the sample loop uses it, no interrupts involved
+static queued_t queue[OUTPUT_QUEUE_SIZE];
+static uint8_t q_head = 0;
+static uint8_t q_tail = 0;
+static uint16_t dropped = 0;
+
+// Line being formatted and written: the fields are appended one step at a time while the start is written
+static char line[48];
+static uint8_t line_len = 0;
+static uint8_t line_pos = 0;
+
+#if OUTPUT_BINARY
+// CRC of the frame bytes written so far
+static uint8_t crc;
+#else
+static uint8_t field = 0;          // Next field to format, 0 when the line is complete
+static uint32_t raw;               // Packet being formatted
+static uint16_t dropped_shown = 0; // Drop count in the last report
+
+/**
+ * Append a literal
+ */
+static void append(const char *s) {
+  while(*s) line[line_len++] = *s++;
+}
+
+/**
+ * Append a value in hex without leading zeros, like Serial.print(val, HEX)
+ */
+static void appendHex(uint32_t val) {
+  uint8_t digits = 1;
+  while(digits < 8 && (val >> (digits * 4))) digits++;
+  while(digits--) line[line_len++] = "0123456789ABCDEF"[(val >> (digits * 4)) & 0xF];
+}
+
+/**
+ * Append a value in decimal
+ */
+static void appendDec(uint16_t val) {
+  char digits[5];
+  uint8_t n = 0;
+  do {
+    digits[n++] = '0' + val % 10;
+    val /= 10;
+  } while(val);
+  while(n) line[line_len++] = digits[--n];
+}
+
+/**
+ * Format the next field of the line: "device:unit group:G channel: C on:O"
+ */
+static void formatField() {
+  switch(field++) {
+    case 1: appendHex(nexa_protocol::device(raw));  append(":"); break;
+    case 2: appendHex(nexa_protocol::unit(raw));    append(" group:"); break;
+    case 3: appendHex(nexa_protocol::group(raw));   append(" channel: "); break;
+    case 4: appendHex(nexa_protocol::channel(raw)); append(" on:"); break;
+    case 5: appendHex(nexa_protocol::on_off(raw));  append("\r\n"); field = 0; break;
+  }
+}
+#endif
+
+/**
+ * Check if the oldest packet can be taken from the queue. In binary mode the newest packet waits until its
+ * repeats are counted.
+ */
+static inline uint8_t ready() {
+  if(q_tail == q_head) return 0;
+#if OUTPUT_BINARY
+  if(((q_tail + 1) & (OUTPUT_QUEUE_SIZE - 1)) == q_head && millis() - queue[q_tail].time_ms < OUTPUT_BURST_MS) {
+    return 0;
+  }
+#endif
+  return 1;
+}
+
+/**
+ * Queue a packet for output
+ */
+uint8_t output_push(uint32_t packet, uint32_t time_ms) {
+  uint8_t next = (q_head + 1) & (OUTPUT_QUEUE_SIZE - 1);
+
+  if(next == q_tail) {
+    if(dropped < 0xFFFF) dropped++;
+    return 0;
+  }
+  queue[q_head].raw = packet;
+  queue[q_head].time_ms = time_ms;
+  queue[q_head].repeats = 1;
+  q_head = next;
+  return 1;
+}
+
+/**
+ * Update the number of frames received of the newest packet, when it is still in the queue
+ */
+void output_repeats(uint32_t packet, uint8_t repeats) {
+  if(q_tail == q_head) return;
+
+  queued_t *newest = &queue[(q_head - 1) & (OUTPUT_QUEUE_SIZE - 1)];
+  if(newest->raw == packet) newest->repeats = repeats;
+}
+
+/**
+ * Do one step of the output: write what is formatted, format one more field or start the next line
+ */
+void output_drain() {
+  if(line_pos < line_len) {
+    for(uint8_t n = 0; n < OUTPUT_SLICE_BYTES && line_pos < line_len && Serial.availableForWrite() > 0; n++) {
+#if OUTPUT_BINARY
+      // The CRC is added once all other bytes are written
+      if(line_pos) crc = packet_crc8(crc, line[line_pos]);
+      if(line_pos == PACKET_FRAME_CRC - 1) line[line_len++] = crc;
+#endif
+      Serial.write(line[line_pos++]);
+    }
+    return;
+  }
+
+#if !OUTPUT_BINARY
+  if(field) {
+    formatField();
+    return;
+  }
+#endif
+
+  // The line is written, start over
+  line_len = 0;
+  line_pos = 0;
+
+#if OUTPUT_BINARY
+  // A frame is filled in one go, the drop counter travels in every frame
+  if(ready()) {
+    queued_t *q = &queue[q_tail];
+    packet_frame_fill((uint8_t *)line, q->raw, q->time_ms, q->repeats, dropped);
+    q_tail = (q_tail + 1) & (OUTPUT_QUEUE_SIZE - 1);
+    line_len = PACKET_FRAME_CRC;
+    crc = 0;
+  }
+#else
+  // Lost packets are reported before the next one
+  if(dropped != dropped_shown) {
+    dropped_shown = dropped;
+    append("Dropped packets: ");
+    appendDec(dropped);
+    append("\r\n");
+    return;
+  }
+
+  if(ready()) {
+    raw = queue[q_tail].raw;
+    q_tail = (q_tail + 1) & (OUTPUT_QUEUE_SIZE - 1);
+    field = 1;
+    formatField();
+  }
+#endif
+}
+
+/**
+ * Check if anything is waiting to be written now
+ */
+uint8_t output_pending() {
+#if OUTPUT_BINARY
+  return line_pos < line_len || ready();
+#else
+  return line_pos < line_len || field || ready() || dropped != dropped_shown;
+#endif
+}
+
+/**
+ * Number of packets dropped because the queue was full
+ */
+uint16_t output_dropped() {
+  return dropped;
+}
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * Deferred packet output - the sample loop queues decoded packets, the serial output happens in its slack time
+ *
+ * Printing a packet takes about 35 characters, tens of milliseconds at 9600 baud, during which the sample loop
+ * used to stand still. Now output_push() only stores the packet in a small queue. output_drain() does one small
+ * step at a time: it formats one field of the line or writes at most OUTPUT_SLICE_BYTES characters, and only
+ * as many as fit in the serial transmit buffer, so it never blocks. When the queue is full the packet is dropped
+ * and counted; the count is printed before the next packet.
+ *
+ * The binary mode writes a frame of 12 bytes per packet instead of a line of about 35 characters (see
+ * packet_frame.h and the host parser in host/packet_parser.h). The frame holds the number of repeats received, so
+ * the newest packet is held back for OUTPUT_BURST_MS while the remote is still sending it.
+ */
+
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include <stdint.h>
+
+// Packets waiting for output, a power of 2
+#define OUTPUT_QUEUE_SIZE 8
+
+// Characters written per step at most
+#define OUTPUT_SLICE_BYTES 2
+
+// Slack needed in the sample interval for one step, in us
+#define OUTPUT_SLICE_US 10
+
+// When set to 1, write binary frames instead of text lines
+#define OUTPUT_BINARY 0
+
+// Binary mode: time to count the repeats of a packet before it is written, in ms (a burst of 6 frames is ~480ms)
+#define OUTPUT_BURST_MS 500
+
+/**
+ * Queue a packet for output
+ * @param time_ms millis() when it was received
+ * @return 0 when the queue is full and the packet was dropped
+ */
+uint8_t output_push(uint32_t raw, uint32_t time_ms);
+
+/**
+ * Update the number of frames received of the newest packet, when it is still in the queue
+ */
+void output_repeats(uint32_t raw, uint8_t repeats);
+
+/**
+ * Do one step of the output, never blocks
+ */
+void output_drain();
+
+/**
+ * Check if anything is waiting to be written
+ */
+uint8_t output_pending();
+
+/**
+ * Number of packets dropped because the queue was full
+ */
+uint16_t output_dropped();
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ * Oversampling front end - turns several fast ADC conversions per sample into one clean receiver sample
+ *
+ * A single reading per sample lets one noise spike flip a sample, and a short pulse is only a few samples long.
+ * With RX_OVERSAMPLE the ADC runs free at its fast 8 bit rate (see adc.h), about OVERSAMPLE_READINGS conversions per
+ * sample, and every conversion is pushed into one of two integer filters over the latest OVERSAMPLE_READINGS
+ * readings. The sample loop takes the filter output once per sample, which decimates the readings to the sample rate.
+ *
+ *   sum:  a moving sum of the readings, sliced once per sample. Four 8 bit readings add up to the 10 bit scale of the
+ *         slicer, so the thresholds stay the same. Averages out wide band noise, but a spike still moves the sum by a
+ *         quarter of its height.
+ *   vote: every reading is compared with the threshold of the slicer (the upper one while the output is 0, the lower
+ *         one while it is 1) and the output follows the majority of the readings; a tie keeps the output. A spike is
+ *         one vote whatever its height, two in a row are needed to flip a sample. The adaptive thresholds follow the
+ *         median of the readings, so a spike does not move them either.
+ *
+ * The push functions run in the conversion complete interrupt and only do a few 8 bit operations; the slicer and
+ * its adaptation run once per sample. This is plain logic without register access so the host tools can run it on
+ * recorded and synthesized ADC traces (host/adcbench).
+ */
+
+#ifndef _OVERSAMPLE_H_
+#define _OVERSAMPLE_H_
+
+#include <stdint.h>
+
+// Hysteresis and threshold tracking
+#include "slicer.h"
+
+// Readings per sample, as a shift: 4 readings of 8 bits sum up to the 10 bit scale of the slicer
+#define OVERSAMPLE_SHIFT 2
+#define OVERSAMPLE_READINGS (1 << OVERSAMPLE_SHIFT)
+#define OVERSAMPLE_MASK (OVERSAMPLE_READINGS - 1)
+
+// Time of one conversion in us: 13 ADC clocks at the 1 MHz of the fast prescaler (PS_16 in adc.h), which gives
+// 4 readings in the default 50us sample interval
+#define OVERSAMPLE_CONVERSION_US 13
+
+// Filters
+#define OVERSAMPLE_SUM 0
+#define OVERSAMPLE_VOTE 1
+
+typedef struct {
+  uint8_t readings[OVERSAMPLE_READINGS];  // The latest readings
+  uint8_t pos;                            // Oldest reading
+  uint16_t sum;                           // Sum: the latest readings added up
+  uint8_t votes;                          // Vote: the latest readings against the threshold, latest in bit 0
+  uint8_t high;                           // Vote: thresholds of the slicer on the 8 bit scale of the readings
+  uint8_t low;
+  slicer_t slicer;
+} oversampler_t;
+
+// Readings above the threshold among the latest 4 (the votes)
+static const uint8_t oversample_ones[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+static_assert(OVERSAMPLE_READINGS == 4, "The vote counts 4 readings");
+
+/**
+ * Start at level 0 with the given slicer thresholds (10 bit ADC scale)
+ */
+static inline void oversample_init(oversampler_t *o, uint16_t high, uint16_t low) {
+  for(uint8_t i = 0; i < OVERSAMPLE_READINGS; i++) o->readings[i] = 0;
+  o->pos = 0;
+  o->sum = 0;
+  o->votes = 0;
+  slicer_init(&o->slicer, high, low);
+  o->high = high >> 2;
+  o->low = low >> 2;
+}
+
+/**
+ * Sum: add a reading (top 8 bits of the conversion) and drop the oldest one
+ */
+static inline void oversample_sum_push(oversampler_t *o, uint8_t reading) {
+  o->sum += reading - o->readings[o->pos];
+  o->readings[o->pos] = reading;
+  o->pos = (o->pos + 1) & OVERSAMPLE_MASK;
+}
+
+/**
+ * Sum: slice the sum of the latest readings
+ * @param sum o->sum, read by the caller with the interrupt held off
+ * @return the sample
+ */
+static inline uint8_t oversample_sum_sample(oversampler_t *o, uint16_t sum, uint8_t adaptive) {
+  return adaptive ? slicer_adapt(&o->slicer, sum) : slicer_step(&o->slicer, sum);
+}
+
+/**
+ * Vote: compare a reading with the threshold for the current output
+ */
+static inline void oversample_vote_push(oversampler_t *o, uint8_t reading) {
+  o->votes = (o->votes << 1) | (reading > (o->slicer.level ? o->low : o->high));
+  o->readings[o->pos] = reading;
+  o->pos = (o->pos + 1) & OVERSAMPLE_MASK;
+}
+
+/**
+ * Median of the latest readings (the mean of the middle two) on the 10 bit scale: what the slicer adapts to, a spike
+ * does not reach it
+ */
+static inline uint16_t oversample_median(const oversampler_t *o) {
+  uint8_t a = o->readings[0], b = o->readings[1], c = o->readings[2], d = o->readings[3], t;
+
+  // Sort the pairs, then the middle two are the larger of the lows and the smaller of the highs
+  if(a > b) { t = a; a = b; b = t; }
+  if(c > d) { t = c; c = d; d = t; }
+  return ((uint16_t)(a > c ? a : c) + (b < d ? b : d)) << 1;
+}
+
+/**
+ * Vote: take the majority of the latest readings and, when adaptive, move the thresholds with their median
+ * @param votes o->votes, read by the caller with the interrupt held off
+ * @return the sample
+ */
+static inline uint8_t oversample_vote_sample(oversampler_t *o, uint8_t votes, uint8_t adaptive) {
+  uint8_t ones = oversample_ones[votes & 0xF];
+
+  if(ones != OVERSAMPLE_READINGS / 2) o->slicer.level = ones > OVERSAMPLE_READINGS / 2;
+  if(adaptive) {
+    slicer_track(&o->slicer, oversample_median(o));
+    o->high = o->slicer.high >> 2;
+    o->low = o->slicer.low >> 2;
+  }
+  return o->slicer.level;
+}
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ * Binary packet frames - the compact output format of the full decoder (OUTPUT_BINARY in output.h)
+ *
+ * Every packet is sent as a frame of PACKET_FRAME_SIZE bytes, multi-byte values least significant byte first:
+ *   0xA7 <raw: 4> <time: 4> <repeats> <dropped> <crc>
+ * raw:      the 32 bit packet (see nexa_pckt_t)
+ * time:     millis() when the first frame of the packet was received
+ * repeats:  number of frames of the packet received, counted until the frame is written
+ * dropped:  number of packets dropped because the output queue was full (total, wraps at 256)
+ * crc:      CRC-8 (polynomial 0x07, initial value 0) of all bytes after the sync byte
+ *
+ * The sync byte can also appear in the payload; a reader that lost track finds the next frame with a valid CRC.
+ * This is plain logic, shared by the sketch and the host parser (host/packet_parser.h).
+ */
+
+#ifndef _PACKET_FRAME_H_
+#define _PACKET_FRAME_H_
+
+#include <stdint.h>
+
+#define PACKET_FRAME_SYNC 0xA7
+#define PACKET_FRAME_SIZE 12
+
+// Offsets in a frame
+#define PACKET_FRAME_RAW      1
+#define PACKET_FRAME_TIME     5
+#define PACKET_FRAME_REPEATS  9
+#define PACKET_FRAME_DROPPED  10
+#define PACKET_FRAME_CRC      11
+
+/**
+ * Add a byte to the CRC-8 (polynomial 0x07, the same as _crc8_ccitt_update() of avr-libc)
+ */
+static inline uint8_t packet_crc8(uint8_t crc, uint8_t data) {
+  crc ^= data;
+  for(uint8_t i = 0; i < 8; i++) {
+    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+/**
+ * Store a 32 bit value, least significant byte first
+ */
+static inline void packet_frame_put32(uint8_t *buf, uint32_t val) {
+  for(uint8_t i = 0; i < 4; i++) buf[i] = val >> (i * 8);
+}
+
+/**
+ * Read a 32 bit value, least significant byte first
+ */
+static inline uint32_t packet_frame_get32(const uint8_t *buf) {
+  return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/**
+ * Fill a frame up to the CRC, which the sender adds while writing the bytes
+ */
+static inline void packet_frame_fill(uint8_t *buf, uint32_t raw, uint32_t time_ms, uint8_t repeats, uint8_t dropped) {
+  buf[0] = PACKET_FRAME_SYNC;
+  packet_frame_put32(buf + PACKET_FRAME_RAW, raw);
+  packet_frame_put32(buf + PACKET_FRAME_TIME, time_ms);
+  buf[PACKET_FRAME_REPEATS] = repeats;
+  buf[PACKET_FRAME_DROPPED] = dropped;
+}
+
+/**
+ * CRC of a filled frame
+ */
+static inline uint8_t packet_frame_crc(const uint8_t *buf) {
+  uint8_t crc = 0;
+  for(uint8_t i = 1; i < PACKET_FRAME_CRC; i++) crc = packet_crc8(crc, buf[i]);
+  return crc;
+}
+
+#endif
@@ -28,31 +28,110 @@
 #define LONG_PULSE 1225
 #define START_PULSE (2675 - SHORT_PULSE)
 
-// Define how many samples we allow to be 'wrong' due to the rising or falling edges
+// Pulse widths as they come out of the receiver, in us. The receiver stretches the low pulses and shortens the
+// high ones compared to the nominal timing above; these values are tuned for the specific setup.
+#define RX_SHORT_HIGH_US 200
+#define RX_SHORT_LOW_US  300
+#define RX_LONG_LOW_US   1200
+#define RX_START_LOW_US  2500
+
+// Define how much a pulse may be 'wrong' due to the rising or falling edges, in us
 // Note: this helps with a noisy receiver but also degrades the precision.
 // Fuzzy matching on the 'short' pulses
-#define FUZZY_SAMPLES_SHORT 1
+#define FUZZY_SHORT_US 50
 // Fuzzy matching on the 'long' and 'sync' pulses
-#define FUZZY_SAMPLES_LONG 2
+#define FUZZY_LONG_US 100
 
 // Number of bits in a packet (between the SYNC and PAUSE signals)
 #define PAYLOAD_SIZE_BITS 64
 
 // --------- Utility defines --------- 
 // Because we will sample multiple times per pulse, compute how many samples make up a 'short' and a 'long' pulse
-//#define SHORT_HIGH_PULSE_SAMPLES (SHORT_PULSE / RX_SAMPLE_INTERVAL_US)
-//#define SHORT_LOW_PULSE_SAMPLES  (SHORT_PULSE / RX_SAMPLE_INTERVAL_US)
-//#define LONG_PULSE_SAMPLES       (LONG_PULSE  / RX_SAMPLE_INTERVAL_US)
-//#define START_PULSE_SAMPLES      (START_PULSE / RX_SAMPLE_INTERVAL_US)
-
-#define SHORT_HIGH_PULSE_SAMPLES 4
-#define SHORT_LOW_PULSE_SAMPLES  6
-#define LONG_PULSE_SAMPLES       24
-#define START_PULSE_SAMPLES      50
+// (rounded to the nearest sample) and how many samples the matching may be off (rounded up, at least 1 sample)
+#define US_TO_SAMPLES(us)       (MAX(1, ((us) + RX_SAMPLE_INTERVAL_US / 2) / RX_SAMPLE_INTERVAL_US))
+#define US_TO_FUZZY_SAMPLES(us) (MAX(1, ((us) + RX_SAMPLE_INTERVAL_US - 1) / RX_SAMPLE_INTERVAL_US))
+
+#define SHORT_HIGH_PULSE_SAMPLES US_TO_SAMPLES(RX_SHORT_HIGH_US)
+#define SHORT_LOW_PULSE_SAMPLES  US_TO_SAMPLES(RX_SHORT_LOW_US)
+#define LONG_PULSE_SAMPLES       US_TO_SAMPLES(RX_LONG_LOW_US)
+#define START_PULSE_SAMPLES      US_TO_SAMPLES(RX_START_LOW_US)
+
+#define FUZZY_SAMPLES_SHORT      US_TO_FUZZY_SAMPLES(FUZZY_SHORT_US)
+#define FUZZY_SAMPLES_LONG       US_TO_FUZZY_SAMPLES(FUZZY_LONG_US)
+
+// --------- Clock recovery --------- 
+// Cheap remotes drift well away from the nominal timing. With clock recovery the fixed windows are only used to find
+// the SYNC, which may be off by CLOCK_TOLERANCE_PERCENT. The rest of the frame is classified against the measured
+// SYNC, refined with the average low pulse of the first bits (a short and a long low always average to the
+// boundary between the two). Without it, every pulse has to fit the fixed FUZZY windows above.
+// The host tools override this to compare both.
+#ifndef CLOCK_RECOVERY
+#define CLOCK_RECOVERY 1
+#endif
+#define CLOCK_TOLERANCE_PERCENT 25
+// Number of low pulses after the SYNC to average (4 bits), a power of 2
+#define CLOCK_LEARN_LOWS 8
+
+// SYNC window with clock recovery, in us and in samples (widened to whole samples)
+#define SYNC_US_MIN         (RX_START_LOW_US * (100 - CLOCK_TOLERANCE_PERCENT) / 100)
+#define SYNC_US_MAX         (RX_START_LOW_US * (100 + CLOCK_TOLERANCE_PERCENT) / 100)
+#define SYNC_SAMPLES_MIN    (SYNC_US_MIN / RX_SAMPLE_INTERVAL_US)
+#define SYNC_SAMPLES_MAX    ((SYNC_US_MAX + RX_SAMPLE_INTERVAL_US - 1) / RX_SAMPLE_INTERVAL_US)
+
+// --------- SYNC correlation --------- 
+// The SYNC is a single long low pulse: one noise sample inside it splits it into two shorter lows and the whole frame
+// is lost before its first bit. With SYNC correlation the pulse detector keeps the latest samples packed in a word and
+// at every rising edge after a low too short for a SYNC counts the ones among the SYNC_CORRELATE_WINDOW samples
+// before the edge (a popcount). At most SYNC_CORRELATE_FLIPS of them make the low a SYNC after all, reported at this
+// edge, where the first bit starts. A weak signal can make data look the same (a long low, a high pulse of a single
+// sample and another long low), so the correlation only applies outside a frame or before its first symbol is complete.
+// At coarse intervals (100 us and up) the shortest valid high pulse is a single sample, every symbol looks like a
+// broken SYNC and no frame outside one can be told from data either: there it is off.
+// The host tools override this to compare both.
+#ifndef SYNC_CORRELATE
+#define SYNC_CORRELATE (SHORT_HIGH_PULSE_SAMPLES - FUZZY_SAMPLES_SHORT > 1)
+#elif SYNC_CORRELATE && SHORT_HIGH_PULSE_SAMPLES - FUZZY_SAMPLES_SHORT <= 1
+#error "SYNC correlation needs a sample interval at which a single high sample is shorter than any valid high pulse"
+#endif
+#define SYNC_CORRELATE_FLIPS 3
+// Samples of the SYNC to match: as many as the shortest SYNC accepted, at most one word of history
+#if CLOCK_RECOVERY
+#define SYNC_CORRELATE_WINDOW MIN(64, SYNC_SAMPLES_MIN)
+#else
+#define SYNC_CORRELATE_WINDOW MIN(64, START_PULSE_SAMPLES - FUZZY_SAMPLES_LONG)
+#endif
 
+#if CLOCK_RECOVERY
+// A lot of low pulses after a frame denotes the end of the frame - a bit more than the slowest SYNC pulse will do
+#define END_PULSE_SAMPLES   (SYNC_SAMPLES_MAX + SHORT_LOW_PULSE_SAMPLES)
+#else
 // A lot of low pulses after a frame denotes the end of the frame - a bit more than the SYNC pulse will do
 #define END_PULSE_SAMPLES   (START_PULSE_SAMPLES + SHORT_LOW_PULSE_SAMPLES + FUZZY_SAMPLES_LONG)
 
+// Sanity: at coarse sample intervals the windows can grow into each other, which makes the pulses ambiguous
+#if SHORT_LOW_PULSE_SAMPLES + FUZZY_SAMPLES_SHORT >= LONG_PULSE_SAMPLES - FUZZY_SAMPLES_LONG
+#error "Sample interval too long: short and long low pulses overlap"
+#endif
+#if LONG_PULSE_SAMPLES + FUZZY_SAMPLES_LONG >= START_PULSE_SAMPLES - FUZZY_SAMPLES_LONG
+#error "Sample interval too long: long and start low pulses overlap"
+#endif
+#endif
+
+// Acceptance windows in us for decoders which measure the pulse width directly (input capture) - these are the
+// sample windows above, widened by half a sample on both sides to account for the sampling uncertainty
+#define PULSE_US_MIN(samples, fuzzy) (((samples) - (fuzzy)) * RX_SAMPLE_INTERVAL_US - RX_SAMPLE_INTERVAL_US / 2)
+#define PULSE_US_MAX(samples, fuzzy) (((samples) + (fuzzy)) * RX_SAMPLE_INTERVAL_US + RX_SAMPLE_INTERVAL_US / 2)
+
+#define SHORT_HIGH_PULSE_US_MIN PULSE_US_MIN(SHORT_HIGH_PULSE_SAMPLES, FUZZY_SAMPLES_SHORT)
+#define SHORT_HIGH_PULSE_US_MAX PULSE_US_MAX(SHORT_HIGH_PULSE_SAMPLES, FUZZY_SAMPLES_SHORT)
+#define SHORT_LOW_PULSE_US_MIN  PULSE_US_MIN(SHORT_LOW_PULSE_SAMPLES,  FUZZY_SAMPLES_SHORT)
+#define SHORT_LOW_PULSE_US_MAX  PULSE_US_MAX(SHORT_LOW_PULSE_SAMPLES,  FUZZY_SAMPLES_SHORT)
+#define LONG_PULSE_US_MIN       PULSE_US_MIN(LONG_PULSE_SAMPLES,       FUZZY_SAMPLES_LONG)
+#define LONG_PULSE_US_MAX       PULSE_US_MAX(LONG_PULSE_SAMPLES,       FUZZY_SAMPLES_LONG)
+#define START_PULSE_US_MIN      PULSE_US_MIN(START_PULSE_SAMPLES,      FUZZY_SAMPLES_LONG)
+#define START_PULSE_US_MAX      PULSE_US_MAX(START_PULSE_SAMPLES,      FUZZY_SAMPLES_LONG)
+#define END_PULSE_US            (END_PULSE_SAMPLES * RX_SAMPLE_INTERVAL_US)
+
 /* http://tech.jolowe.se/home-automation-rf-protocols/
 Packetformat
 Every packet consists of a sync bit followed by 26 + 2 + 4 (total 32 logical data part bits) and is ended by a pause bit.
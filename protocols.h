@@ -0,0 +1,90 @@
+/**
+ * Protocol descriptors - everything the frame decoder needs to know about a protocol, resolved at compile time
+ *
+ * A descriptor is a struct with only static constexpr members:
+ *   word_t            integer type holding a whole frame
+ *   bits              number of symbols in a frame (between SYNC and PAUSE)
+ *   sync_us, ...      receiver pulse widths, the pulse detector is shared by all protocols with the same widths
+ *   symbol(lows, n)   value of symbol n given the lengths of its two low pulses (SYMBOL_LOWS_*), or SYMBOL_INVALID
+ *   accept(word)      whether a complete frame belongs to this protocol
+ *   device(word), ... payload layout
+ *
+ * The frame decoder (frame_decoder.h) is specialized for every descriptor, so none of this costs anything at run
+ * time. All protocols here are variants of the Nexa self-learning protocol: a symbol is a short high, a low, a short
+ * high and a low, and the length of the two lows gives its value:
+ *   hLhl = 1, hlhL = 0, hlhl = dim (Nexa dimmer only, in place of the on/off bit)
+ */
+
+#ifndef _PROTOCOLS_H_
+#define _PROTOCOLS_H_
+
+#include <stdint.h>
+
+// Receiver pulse widths
+#include "protocol.h"
+
+// Lengths of the two lows of a symbol: bit 1 is set when the first low is long, bit 0 when the second is
+#define SYMBOL_LOWS_0   0x1
+#define SYMBOL_LOWS_1   0x2
+#define SYMBOL_LOWS_DIM 0x0
+
+// Symbol value for patterns which are not part of the protocol
+#define SYMBOL_INVALID 0xFF
+
+// Pulse widths of the Nexa family as they come out of the receiver
+struct nexa_timing {
+  static constexpr uint16_t high_us  = RX_SHORT_HIGH_US;
+  static constexpr uint16_t short_us = RX_SHORT_LOW_US;
+  static constexpr uint16_t long_us  = RX_LONG_LOW_US;
+  static constexpr uint16_t sync_us  = RX_START_LOW_US;
+};
+
+/**
+ * Nexa: 32 bits - 26 bit device id, group, on/off, 2 channel bits and 2 unit bits (see nexa_pckt_t).
+ * Any 32 bit frame is accepted, as the decoder always did. The unit is the raw code: #1 is sent as 11.
+ */
+struct nexa_protocol : nexa_timing {
+  typedef uint32_t word_t;
+  static constexpr uint8_t bits = 32;
+
+  static constexpr uint8_t symbol(uint8_t lows, uint8_t) {
+    return lows == SYMBOL_LOWS_1 ? 1 : lows == SYMBOL_LOWS_0 ? 0 : SYMBOL_INVALID;
+  }
+  static constexpr uint8_t accept(word_t) { return 1; }
+
+  static constexpr uint32_t device(word_t w)  { return w >> 6; }
+  static constexpr uint8_t  group(word_t w)   { return (w >> 5) & 0x1; }
+  static constexpr uint8_t  on_off(word_t w)  { return (w >> 4) & 0x1; }
+  static constexpr uint8_t  channel(word_t w) { return (w >> 2) & 0x3; }
+  static constexpr uint8_t  unit(word_t w)    { return w & 0x3; }
+};
+
+/**
+ * Proove/Anslut: the same frame as Nexa, told apart by channel bits 00; unit #1 is sent as 00
+ */
+struct proove_protocol : nexa_protocol {
+  static constexpr uint8_t accept(word_t w) { return channel(w) == 0; }
+};
+
+/**
+ * Nexa dimmer: 36 bits - the Nexa frame with a dim symbol in place of the on/off bit, followed by a 4 bit dim level
+ */
+struct nexa_dimmer_protocol : nexa_timing {
+  typedef uint64_t word_t;
+  static constexpr uint8_t bits = 36;
+  static constexpr uint8_t dim_symbol = 27;
+
+  static constexpr uint8_t symbol(uint8_t lows, uint8_t n) {
+    return n == dim_symbol ? (lows == SYMBOL_LOWS_DIM ? 0 : SYMBOL_INVALID) :
+           lows == SYMBOL_LOWS_1 ? 1 : lows == SYMBOL_LOWS_0 ? 0 : SYMBOL_INVALID;
+  }
+  static constexpr uint8_t accept(word_t) { return 1; }
+
+  static constexpr uint32_t device(word_t w)  { return w >> 10; }
+  static constexpr uint8_t  group(word_t w)   { return (w >> 9) & 0x1; }
+  static constexpr uint8_t  channel(word_t w) { return (w >> 6) & 0x3; }
+  static constexpr uint8_t  unit(word_t w)    { return (w >> 4) & 0x3; }
+  static constexpr uint8_t  level(word_t w)   { return w & 0xF; }
+};
+
+#endif
@@ -0,0 +1,308 @@
+/**
+ * Receiver - the full decoder as one template, put together from a sample source and a packet sink
+ *
+ * A receiver takes its input and its output as policies: receiver<Source, Sink> reads a sample from the source,
+ * pushes it through the full decoder (decodeSample(), with the voting and debouncer settings of decoder_full.h) and
+ * hands every new packet to the sink. Both are plain structs whose calls are resolved at compile time and inlined,
+ * so reading a pin through a policy costs the same as reading it directly, and several receivers with different
+ * inputs fit one sketch. The sample loop of the full decoder is one, reading rx_source_t, the input picked by the
+ * settings of sampler.h.
+ *
+ * A source has begin(), available() (0 once a recorded source runs out) and read() (the next sample, 0 or 1):
+ *   digital_source<pin>          digitalRead() of a pin                                    (board)
+ *   analog_source<pin>           analogRead() of a pin through the slicer (slicer.h)       (board)
+ *   freerun_source               the level of the free-running ADC, RX_ANALOG_FREERUN      (board)
+ *   oversample_source            the fast ADC readings filtered, RX_OVERSAMPLE             (board)
+ *   port_source<Port, bit>       one bit of a port register, see RX_PORT_PIN()             (board)
+ *   buffer_source                one sample per byte, e.g. a signal made by host/synth.h
+ *   packed_source                8 samples per byte, first in the MSB, as the recorder captures them
+ *   synth_source                 a pulse train sampled as it is read                       (host/synth.h)
+ *   inverted<Source>             any source, inverted
+ * A sink has packet(raw, time_ms) for a new packet, repeats(newest) after every sample without one (the entry of
+ * the debouncer which counts the repeats of the newest packet) and idle(us), called with the time left in the sample
+ * interval:
+ *   null_sink                    drops the packets, to measure the decoder
+ *   serial_sink                  queues them for the serial port and writes in the slack time (output.h, board)
+ *   dispatch_sink                passes them to the handlers of devices.cpp (ENABLE_DISPATCH, board)
+ *   both_sinks<A, B>             passes them to two sinks
+ *
+ * The whole decoder is header only (decoder.h, frame_decoder.h, soft_decoder.h, decoder_full.h) and this header
+ * does not load config.h, so a receiver compiles into any module of the sketch and into the host tools without
+ * linking a decoder module. The board sinks only need their module when they are used: serial_sink the output of
+ * output.cpp (built with the full decoder), dispatch_sink the handlers of devices.cpp (ENABLE_DISPATCH).
+ */
+
+#ifndef _RECEIVER_H_
+#define _RECEIVER_H_
+
+#include <stdint.h>
+
+// Decoder context and decodeSample(), the sampler settings
+#include "decoder_full.h"
+// Hysteresis for analog sources
+#include "slicer.h"
+
+#ifdef ARDUINO
+// Board sinks
+#include "output.h"
+#include "devices.h"
+#endif
+
+// ------------------------- Sample sources --------------------------
+
+#ifdef ARDUINO
+/**
+ * Digital pin
+ */
+template<uint8_t pin>
+struct digital_source {
+  void begin() { pinMode(pin, INPUT); }
+  uint8_t available() { return 1; }
+  uint8_t read() { return digitalRead(pin); }
+};
+
+/**
+ * Analog pin, sliced with hysteresis; the levels are on the 10 bit scale of the ADC, adaptive ones are only the start
+ */
+template<uint8_t pin, uint16_t high = RX_ANALOG_LEVEL_HIGH, uint16_t low = RX_ANALOG_LEVEL_LOW,
+         uint8_t adaptive = RX_ANALOG_ADAPTIVE>
+struct analog_source {
+  slicer_t slicer;
+
+  void begin() { slicer_init(&slicer, high, low); }
+  uint8_t available() { return 1; }
+  uint8_t read() {
+    uint16_t val = analogRead(pin);
+    return adaptive ? slicer_adapt(&slicer, val) : slicer_step(&slicer, val);
+  }
+};
+
+#if RX_ANALOG && RX_ANALOG_FREERUN
+/**
+ * Free-running ADC: its interrupt slices every conversion, the sample is the latest level (adc_start_freerun())
+ */
+struct freerun_source {
+  void begin() {}
+  uint8_t available() { return 1; }
+  uint8_t read() { return adc_sample(); }
+};
+#endif
+
+#if RX_ANALOG && RX_OVERSAMPLE
+/**
+ * Oversampling ADC: its interrupt pushes the fast conversions into the filter, the sample is taken from the
+ * readings since the last one (adc_start_freerun())
+ */
+struct oversample_source {
+  void begin() {}
+  uint8_t available() { return 1; }
+  uint8_t read() { return adc_oversample(); }
+};
+#endif
+
+// Port register for port_source: RX_PORT_PIN(port_c, PINC) declares the type port_c
+#define RX_PORT_PIN(name, reg) struct name { static inline uint8_t pin() { return reg; } }
+
+/**
+ * One bit of a port register, read without going through digitalRead(): a single instruction
+ */
+template<typename Port, uint8_t bit>
+struct port_source {
+  void begin() {}
+  uint8_t available() { return 1; }
+  uint8_t read() { return (Port::pin() >> bit) & 0x1; }
+};
+#endif
+
+/**
+ * Samples in memory, one per byte
+ */
+struct buffer_source {
+  const uint8_t *samples;
+  unsigned long count;
+  unsigned long pos;
+
+  void begin() { pos = 0; }
+  uint8_t available() { return pos < count; }
+  uint8_t read() { return samples[pos++]; }
+};
+
+/**
+ * Samples in memory, packed 8 per byte with the first one in the most significant bit
+ */
+struct packed_source {
+  const uint8_t *data;
+  unsigned long count;         // Samples, 8 per byte
+  unsigned long pos;
+
+  void begin() { pos = 0; }
+  uint8_t available() { return pos < count; }
+  uint8_t read() {
+    uint8_t val = (data[pos >> 3] >> (7 - (pos & 0x7))) & 0x1;
+    pos++;
+    return val;
+  }
+};
+
+/**
+ * Any source behind a receiver which inverts the levels
+ */
+template<typename Source>
+struct inverted : Source {
+  uint8_t read() { return !Source::read(); }
+};
+
+#ifdef ARDUINO
+// The receiver input picked by the settings of sampler.h, the source of the sample loops of the sketch; analog
+// reading is needed when the receiver is running at 3.3V
+#if RX_OVERSAMPLE
+typedef oversample_source rx_pin_source_t;
+#elif RX_ANALOG && RX_ANALOG_FREERUN
+typedef freerun_source rx_pin_source_t;
+#elif RX_ANALOG
+typedef analog_source<rxPinAna> rx_pin_source_t;
+#else
+typedef digital_source<rxPin> rx_pin_source_t;
+#endif
+
+#if RX_INVERT
+typedef inverted<rx_pin_source_t> rx_source_t;
+#else
+typedef rx_pin_source_t rx_source_t;
+#endif
+#endif
+
+// ------------------------- Packet sinks ----------------------------
+
+/**
+ * Drops the packets
+ */
+struct null_sink {
+  void packet(uint32_t, uint32_t) {}
+  void repeats(const dedup_entry_t *) {}
+  void idle(uint16_t) {}
+};
+
+#ifdef ARDUINO
+/**
+ * Queues the packets for the serial port, written a little at a time when the sample interval has time left; in
+ * binary mode the repeats of the newest packet are counted as they come in
+ */
+struct serial_sink {
+  uint8_t count;               // Repeats of the newest packet passed on
+
+  void packet(uint32_t raw, uint32_t time_ms) {
+    output_push(raw, time_ms);
+    count = 1;
+  }
+  void repeats(const dedup_entry_t *newest) {
+#if OUTPUT_BINARY
+    if(newest->repeats != count) {
+      count = newest->repeats;
+      output_repeats(newest->raw, count);
+    }
+#else
+    (void)newest;
+#endif
+  }
+  void idle(uint16_t us) {
+    if(us > OUTPUT_SLICE_US) output_drain();
+  }
+};
+
+/**
+ * Passes the packets to the handlers of devices.cpp
+ */
+struct dispatch_sink {
+  void packet(uint32_t raw, uint32_t) { devices_dispatch(raw); }
+  void repeats(const dedup_entry_t *) {}
+  void idle(uint16_t) {}
+};
+#endif
+
+/**
+ * Passes the packets to two sinks, the first one first; only the first one gets the idle time
+ */
+template<typename A, typename B>
+struct both_sinks {
+  A first;
+  B second;
+
+  void packet(uint32_t raw, uint32_t time_ms) {
+    first.packet(raw, time_ms);
+    second.packet(raw, time_ms);
+  }
+  void repeats(const dedup_entry_t *newest) {
+    first.repeats(newest);
+    second.repeats(newest);
+  }
+  void idle(uint16_t us) { first.idle(us); }
+};
+
+// ------------------------- Receiver --------------------------------
+
+template<typename Source, typename Sink>
+struct receiver {
+  Source source;
+  Sink sink;
+  nexa_decoder_t decoder;
+
+  /**
+   * Start the source and reset the decoder, including the debouncer
+   */
+  void begin() {
+    source.begin();
+    decoder_init(&decoder);
+  }
+
+  /**
+   * Decode the next sample of the source
+   * @return 1 when a new packet went to the sink
+   */
+  uint8_t sample() {
+    return deliver(decodeSample(&decoder, source.read()));
+  }
+
+  /**
+   * Hand the result of the decoder to the sink, for loops which decode the sample themselves
+   * @param res result of decodeSample()
+   * @return res
+   */
+  uint8_t deliver(uint8_t res) {
+    const dedup_entry_t *newest = dedup_last(&decoder.dedup);
+    if(res) sink.packet(lastPacket(&decoder), newest->time_ms);
+    else sink.repeats(newest);
+    return res;
+  }
+
+  /**
+   * Decode the source up to its end, for recorded and synthesized sources
+   * @return the number of new packets
+   */
+  unsigned long run() {
+    unsigned long packets = 0;
+    while(source.available()) packets += sample();
+    return packets;
+  }
+
+#ifdef ARDUINO
+  /**
+   * Sample loop: one sample every RX_SAMPLE_INTERVAL_US, the sink gets the time left over. Does not return.
+   */
+  void loop() {
+    while(1) {
+      unsigned long time = micros();
+      sample();
+
+      unsigned long dur = micros() - time;
+      if(dur < RX_SAMPLE_INTERVAL_US) sink.idle(RX_SAMPLE_INTERVAL_US - dur);
+
+      // Correct time offset due to computations
+      dur = micros() - time;
+      if(dur < RX_SAMPLE_INTERVAL_US) delayMicroseconds(RX_SAMPLE_INTERVAL_US - dur);
+    }
+  }
+#endif
+};
+
+#endif
@@ -1,10 +1,175 @@
 
 #include "recorder.h"
+#include "rle.h"
+// The receiver input as a sample source
+#include "receiver.h"
 #include "Arduino.h"
 
 // Global pointer to the memory allocated to hold the recording
 uint8_t *recording = (uint8_t *)-1;
 
+#if RECORDER_STREAM
+// Two halves of the sample buffer: one is filled while the other is sent
+static uint8_t stream_buf[2][RECORDER_STREAM_BLOCK];
+static uint8_t fill_half = 0;      // Half being filled
+static uint8_t fill_pos = 0;       // Next byte to fill
+static uint8_t send_pos = 0;       // Next byte to send of the other half, including the header
+static uint8_t sending = 0;        // Set while the other half is being sent
+static uint8_t header[RECORDER_STREAM_HEADER] = { RECORDER_STREAM_SYNC0, RECORDER_STREAM_SYNC1, 0, 0, 0 };
+static uint8_t seq = 0;            // Block counter
+static uint8_t dropped = 0;        // Blocks dropped because the serial port was too slow
+static uint8_t late = 0;           // Late samples in the block being filled
+
+/**
+ * Send a few bytes of the pending block, only as much as fits in the serial transmit buffer so this never blocks
+ */
+static inline void sendSome() {
+  // Sending at most 2 bytes per sample is plenty: a block takes 512 samples (64 raw) to fill and 69 bytes to send
+  for(uint8_t n = 0; n < 2 && sending && Serial.availableForWrite() > 0; n++) {
+    if(send_pos < RECORDER_STREAM_HEADER) {
+      Serial.write(header[send_pos]);
+    } else {
+      Serial.write(stream_buf[fill_half ^ 1][send_pos - RECORDER_STREAM_HEADER]);
+    }
+    if(++send_pos == RECORDER_STREAM_HEADER + RECORDER_STREAM_BLOCK) sending = 0;
+  }
+}
+
+/**
+ * Pack a sample into the half being filled, hand the half over to the sender when it is full
+ */
+static inline void pushSample(uint8_t val) {
+#if RECORDER_STREAM_RAW
+  // val is already a whole byte
+  stream_buf[fill_half][fill_pos] = val;
+#else
+  static uint8_t curbyte = 0;
+  static uint8_t bitcnt = 0;
+
+  curbyte = (curbyte << 1) | (val & 0x1);
+  if(++bitcnt < 8) return;
+
+  bitcnt = 0;
+  stream_buf[fill_half][fill_pos] = curbyte;
+#endif
+  if(++fill_pos < RECORDER_STREAM_BLOCK) return;
+
+  fill_pos = 0;
+  if(sending) {
+    // The previous block is still being sent: drop this one and refill the same half. The host sees the
+    // gap in the sequence numbers and the dropped counter.
+    dropped++;
+  } else {
+    header[2] = seq;
+    header[3] = dropped;
+    header[4] = late;
+    send_pos = 0;
+    sending = 1;
+    fill_half ^= 1;
+  }
+  seq++;
+  late = 0;
+}
+
+/**
+ * Main control loop for the streaming recorder: sample, pack, send a little, wait
+ */
+void recorder_loop() {
+  unsigned long time, dur, wait;
+#if !RECORDER_STREAM_RAW
+  rx_source_t source;
+
+  source.begin();
+#endif
+
+  // Give the host a moment to start listening, everything after this line is binary
+#if RECORDER_STREAM_RAW
+  Serial.print("Streaming ADC readings, interval in us: ");
+#else
+  Serial.print("Streaming samples, interval in us: ");
+#endif
+  Serial.println(RX_SAMPLE_INTERVAL_US);
+  Serial.flush();
+
+  while(1) {
+    // Grab current time
+    time = micros();
+    
+    // Sample from the antenna
+#if RECORDER_STREAM_RAW
+    uint8_t val = readRxAdc() >> 2;
+#else
+    uint8_t val = source.read();
+#endif
+    
+    // Store into the sample buffer and send part of the other half
+    pushSample(val);
+    sendSome();
+    
+    // Correct time offset due to computations - when too slow, count it and carry on
+    dur = micros() - time;
+    if(dur >= RX_SAMPLE_INTERVAL_US) {
+      if(late < 255) late++;
+      continue;
+    }
+    wait = RX_SAMPLE_INTERVAL_US - dur;
+    
+    // Wait for the next sampling point
+    delayMicroseconds(wait);
+  }
+}
+#else
+#if RECORDER_RLE
+/**
+ * Print the run-length recording as hex, 32 bytes per line, and lock up
+ */
+static void dumpRle(uint16_t bytes) {
+  Serial.println("Recording complete");
+  Serial.print("RLE bytes: ");
+  Serial.println(bytes);
+
+  for(uint16_t i = 0; i < bytes; i++) {
+    if(recording[i] < 0x10) Serial.print("0");
+    Serial.print(recording[i], HEX);
+    if(i % 32 == 31) Serial.println();
+  }
+  Serial.println();
+
+  while(1) {}
+}
+
+/**
+ * Run-length recording: only store something when the level changes
+ */
+inline void pushSample(uint8_t val) {
+  static rle_writer_t rle;        // Pulse widths, behind the first byte
+  static unsigned long scnt = 0;  // Number of samples recorded
+  static uint32_t run = 0;        // Length of the current pulse
+  static uint8_t level = 0;       // Level of the current pulse
+
+  // The first byte holds the level of the first pulse
+  if(scnt == 0) {
+    recording[0] = val;
+    rle_init(&rle, recording + 1, RECORDER_RLE_BYTES - 1);
+    level = val;
+  }
+
+  if(val != level) {
+    // Pulse complete - store its length
+    if(!rle_push(&rle, level, run)) dumpRle(1 + rle_finish(&rle));
+    level = val;
+    run = 0;
+  }
+  run++;
+  scnt++;
+
+  // Done, store the pulse in progress and print
+  if(scnt == RECORDER_RLE_SAMPLES) {
+    rle_push(&rle, level, run);
+    dumpRle(1 + rle_finish(&rle));
+  }
+}
+#else
 inline void pushSample(uint8_t val) {
   static unsigned long scnt = 0;
   static uint8_t curbyte = 0;
@@ -41,36 +206,51 @@ inline void pushSample(uint8_t val) {
     while(1) {} 
   }
 }
+#endif
 
 /**
  * Main control loop for the recorder logic
  */
 void recorder_loop() {
   unsigned long time, dur, wait;
+  rx_source_t source;
+
+  source.begin();
+
+#if RECORDER_RLE
+  const unsigned int bytes = RECORDER_RLE_BYTES;
+#else
+  const unsigned int bytes = RECORDER_BYTES;
+#endif
 
   // Allocate memory for the recording
   // Note that this will fail if too many samples are requested
-  recording = (uint8_t *)malloc(RECORDER_BYTES);
+  recording = (uint8_t *)malloc(bytes);
   if((int)recording == 0) {
     Serial.println("Could not allocate memory of ");
-    Serial.print(RECORDER_BYTES);
+    Serial.print(bytes);
     Serial.println(" bytes");
     while(1) {}
   }
   
   Serial.print("Sample interval: ");
   Serial.print(RX_SAMPLE_INTERVAL_US);
+#if RECORDER_RLE
+  Serial.print("us\nMax samples in RLE recording: ");
+  Serial.println(RECORDER_RLE_SAMPLES);
+#else
   Serial.print("us\nSamples in recording: ");
   Serial.println(RECORDER_SAMPLES);
+#endif
   Serial.print("Bytes in recording: ");
-  Serial.println(RECORDER_BYTES);
+  Serial.println(bytes);
 
   while(1) {
     // Grab current time
     time = micros();
     
     // Sample from the antenna
-    uint8_t val = readRxPin();
+    uint8_t val = source.read();
     
     // Store into the correct sample buffer
     pushSample(val);
@@ -92,3 +272,4 @@ void recorder_loop() {
   Serial.println(RX_SAMPLE_INTERVAL_US);
   while(1) {}
 }
+#endif
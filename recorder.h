@@ -18,6 +18,48 @@
 // Compute how many bytes are needed for the trace
 #define RECORDER_BYTES (RECORDER_SAMPLES / 8)
 
+// Run-length mode: instead of one bit per sample, store the width of every pulse in a prefix code of a few bits
+// (see rle.h). The first byte holds the level of the first pulse. Measured with host/recbench (bursts of 5 frames
+// 1 s apart at the default 50 us), the buffer below holds 45 frames of a clean signal and 34 with 25 us of edge
+// jitter: 9 and 6 whole bursts, where one variable length number per pulse held 9 frames. Noise costs more, a
+// receiver which outputs noise between bursts fills it within 2 seconds.
+// The dump is printed as hex; the host replay tool reads it with -r.
+#define RECORDER_RLE 0
+
+// Size of the run-length buffer in bytes and the maximum recording time in seconds (the recording also ends
+// when the buffer is full)
+#define RECORDER_RLE_BYTES 1250
+#define RECORDER_RLE_SECONDS 300
+
+// Compute how many samples the run-length recording may take at most
+#define RECORDER_RLE_SAMPLES (RECORDER_RLE_SECONDS * (1000000UL / RX_SAMPLE_INTERVAL_US))
+
+// Streaming mode: record indefinitely by sending the samples to the host while recording. The samples are packed
+// 8 per byte into two halves of a buffer: one half is sent while the other fills. Every half is sent as a block:
+//   0xA5 0x5A <sequence> <dropped> <late> <RECORDER_STREAM_BLOCK bytes of samples>
+// sequence: block counter, a gap means blocks were lost on the way to the host
+// dropped:  number of blocks dropped because the serial port could not keep up (total, wraps at 256)
+// late:     samples in this block taken too late because the loop ran out of time (saturates at 255)
+// Needs a fast serial link (SERIAL_BAUD_STREAM); the host replay tool reads a capture of the stream with -s.
+#define RECORDER_STREAM 0
+
+// Bytes of samples per block (half the buffer)
+#define RECORDER_STREAM_BLOCK 64
+
+// Raw streaming: every byte of a block is one ADC reading (the top 8 of 10 bits) instead of 8 samples, for tuning
+// the analog slicer on the host (replay -s -A / -T). Needs 1 byte per sample: at the default 50us interval this is
+// close to the limit of SERIAL_BAUD_STREAM, use a longer interval when blocks get dropped.
+#define RECORDER_STREAM_RAW 0
+
+// Block header
+#define RECORDER_STREAM_SYNC0 0xA5
+#define RECORDER_STREAM_SYNC1 0x5A
+#define RECORDER_STREAM_HEADER 5
+
+#if RECORDER_STREAM && RECORDER_RLE
+#error "Select either the streaming or the run-length recorder"
+#endif
+
 /**
  * Main control loop for the recorder logic
  */
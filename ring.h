@@ -0,0 +1,74 @@
+/**
+ * Lock-free single producer / single consumer byte ring
+ *
+ * The producer (an interrupt) only writes the head, the consumer (the main loop) only writes the tail, so no
+ * locking is needed as long as there is exactly one of each. The indices are single bytes which are read and
+ * written atomically on the AVR; the atomic builtins only add the ordering needed on the host.
+ */
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stdint.h>
+
+// Ring size in bytes, must be a power of 2 and at most 128; one slot is kept free to tell full from empty
+#define RING_SIZE 64
+
+typedef struct {
+  uint8_t head;              // Next slot to write, producer only
+  uint8_t tail;              // Next slot to read, consumer only
+  uint8_t data[RING_SIZE];
+} ring_t;
+
+/**
+ * Empty the ring, only when neither side is running
+ */
+static inline void ring_init(ring_t *r) {
+  r->head = 0;
+  r->tail = 0;
+}
+
+/**
+ * Producer side: add a byte
+ * @return 0 when the ring is full and the byte was not added
+ */
+static inline uint8_t ring_push(ring_t *r, uint8_t val) {
+  uint8_t head = r->head;
+  uint8_t next = (head + 1) & (RING_SIZE - 1);
+
+  if(next == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) return 0;
+
+  r->data[head] = val;
+  __atomic_store_n(&r->head, next, __ATOMIC_RELEASE);
+  return 1;
+}
+
+/**
+ * Consumer side: take the oldest byte
+ * @return 0 when the ring is empty
+ */
+static inline uint8_t ring_pop(ring_t *r, uint8_t *val) {
+  uint8_t tail = r->tail;
+
+  if(tail == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) return 0;
+
+  *val = r->data[tail];
+  __atomic_store_n(&r->tail, (tail + 1) & (RING_SIZE - 1), __ATOMIC_RELEASE);
+  return 1;
+}
+
+/**
+ * Producer side: number of bytes which can be added
+ */
+static inline uint8_t ring_space(ring_t *r) {
+  return (__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) - r->head - 1) & (RING_SIZE - 1);
+}
+
+/**
+ * Consumer side: number of bytes waiting
+ */
+static inline uint8_t ring_count(ring_t *r) {
+  return (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - r->tail) & (RING_SIZE - 1);
+}
+
+#endif
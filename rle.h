@@ -0,0 +1,191 @@
+/**
+ * Run-length code of the recorder - pulse widths in a prefix code of a few bits
+ *
+ * The pulses alternate in level, so every pulse is coded for its level, most significant bit first:
+ *   high  0 the width of a short high (protocol.h), 10 one sample shorter, 110 one sample longer
+ *   low   00 a short low, 01 a long low, 100 and 101 one sample shorter, 1100 and 1101 one sample longer
+ *   both  111 followed by the width in groups of 4 bits: 3 bits of the width, least significant first, and a top bit
+ *         set when more follow (the SYNC, the pauses and anything away from the protocol timing)
+ * The code is exact: the jitter of the receiver stays in the recording, only the widths away from the protocol
+ * timing cost more. At the default 50 us a frame takes about 28 bytes of a clean signal and 37 with 25 us of edge
+ * jitter, the silence up to the next burst included (host/recbench.cpp).
+ * The last byte is padded with ones, which are never a complete pulse.
+ *
+ * This is plain logic so the host tools can use it (host/recbench.cpp encodes, host/replay.cpp decodes).
+ */
+
+#ifndef _RLE_H_
+#define _RLE_H_
+
+#include <stdint.h>
+
+// Pulse widths in samples
+#include "protocol.h"
+
+// Escape code of both levels, followed by the width
+#define RLE_ESCAPE      0x7
+#define RLE_ESCAPE_BITS 3
+
+// Longest code
+#define RLE_MAX_BITS 4
+
+typedef struct {
+  uint8_t code;            // Right aligned
+  uint8_t bits;
+  int16_t width;           // In samples
+} rle_symbol_t;
+
+#define RLE_HIGH_SYMBOLS 3
+#define RLE_LOW_SYMBOLS  6
+
+static const rle_symbol_t rle_high[RLE_HIGH_SYMBOLS] = {
+  { 0x0, 1, SHORT_HIGH_PULSE_SAMPLES },
+  { 0x2, 2, SHORT_HIGH_PULSE_SAMPLES - 1 },
+  { 0x6, 3, SHORT_HIGH_PULSE_SAMPLES + 1 },
+};
+
+static const rle_symbol_t rle_low[RLE_LOW_SYMBOLS] = {
+  { 0x0, 2, SHORT_LOW_PULSE_SAMPLES },
+  { 0x1, 2, LONG_PULSE_SAMPLES },
+  { 0x4, 3, SHORT_LOW_PULSE_SAMPLES - 1 },
+  { 0x5, 3, LONG_PULSE_SAMPLES - 1 },
+  { 0xC, 4, SHORT_LOW_PULSE_SAMPLES + 1 },
+  { 0xD, 4, LONG_PULSE_SAMPLES + 1 },
+};
+
+/**
+ * Symbol of a pulse
+ * @return NULL when the width has none and is escaped
+ */
+static inline const rle_symbol_t *rle_symbol(uint8_t level, uint32_t run) {
+  const rle_symbol_t *s = level ? rle_high : rle_low;
+  uint8_t n = level ? RLE_HIGH_SYMBOLS : RLE_LOW_SYMBOLS;
+
+  for(uint8_t i = 0; i < n; i++) {
+    if((uint32_t)s[i].width == run) return &s[i];
+  }
+  return 0;
+}
+
+/**
+ * Bits a pulse takes
+ */
+static inline uint8_t rle_bits(uint8_t level, uint32_t run) {
+  const rle_symbol_t *s = rle_symbol(level, run);
+  if(s) return s->bits;
+
+  uint8_t n = RLE_ESCAPE_BITS + 4;
+  for(run >>= 3; run; run >>= 3) n += 4;
+  return n;
+}
+
+typedef struct {
+  uint8_t *buf;
+  uint16_t size;           // Bytes in the buffer
+  uint16_t pos;            // Next bit
+} rle_writer_t;
+
+static inline void rle_init(rle_writer_t *w, uint8_t *buf, uint16_t size) {
+  w->buf = buf;
+  w->size = size;
+  w->pos = 0;
+}
+
+/**
+ * Append the lowest bits of a code, most significant first
+ */
+static inline void rle_put(rle_writer_t *w, uint8_t code, uint8_t bits) {
+  while(bits--) {
+    uint8_t mask = 0x80 >> (w->pos & 0x7);
+    if(mask == 0x80) w->buf[w->pos >> 3] = 0;
+    if((code >> bits) & 0x1) w->buf[w->pos >> 3] |= mask;
+    w->pos++;
+  }
+}
+
+/**
+ * Append a pulse
+ * @return 0 when it does not fit
+ */
+static inline uint8_t rle_push(rle_writer_t *w, uint8_t level, uint32_t run) {
+  if(w->pos + rle_bits(level, run) > (uint32_t)w->size * 8) return 0;
+
+  const rle_symbol_t *s = rle_symbol(level, run);
+  if(s) {
+    rle_put(w, s->code, s->bits);
+    return 1;
+  }
+
+  rle_put(w, RLE_ESCAPE, RLE_ESCAPE_BITS);
+  while(run >= 0x8) {
+    rle_put(w, (run & 0x7) | 0x8, 4);
+    run >>= 3;
+  }
+  rle_put(w, run, 4);
+  return 1;
+}
+
+/**
+ * Pad the last byte
+ * @return the number of bytes written
+ */
+static inline uint16_t rle_finish(rle_writer_t *w) {
+  while(w->pos & 0x7) rle_put(w, 0x1, 1);
+  return w->pos >> 3;
+}
+
+typedef struct {
+  const uint8_t *buf;
+  unsigned long bits;      // Bits in the buffer
+  unsigned long pos;       // Next bit
+} rle_reader_t;
+
+static inline void rle_reader_init(rle_reader_t *r, const uint8_t *buf, unsigned long bytes) {
+  r->buf = buf;
+  r->bits = bytes * 8;
+  r->pos = 0;
+}
+
+/**
+ * Read bits onto a code
+ * @return 0 at the end of the buffer
+ */
+static inline uint8_t rle_get(rle_reader_t *r, uint8_t *code, uint8_t bits) {
+  for(; bits; bits--, r->pos++) {
+    if(r->pos == r->bits) return 0;
+    *code = (*code << 1) | ((r->buf[r->pos >> 3] >> (7 - (r->pos & 0x7))) & 0x1);
+  }
+  return 1;
+}
+
+/**
+ * Read the next pulse
+ * @return 0 at the end of the buffer, the padding included
+ */
+static inline uint8_t rle_next(rle_reader_t *r, uint8_t level, uint32_t *run) {
+  const rle_symbol_t *s = level ? rle_high : rle_low;
+  uint8_t n = level ? RLE_HIGH_SYMBOLS : RLE_LOW_SYMBOLS;
+  uint8_t code = 0, bits = 0;
+
+  // One bit at a time until the code is complete, none is the start of another
+  while(bits != RLE_ESCAPE_BITS || code != RLE_ESCAPE) {
+    if(bits == RLE_MAX_BITS || !rle_get(r, &code, 1)) return 0;
+    bits++;
+    for(uint8_t i = 0; i < n; i++) {
+      if(s[i].bits == bits && s[i].code == code) {
+        *run = s[i].width;
+        return 1;
+      }
+    }
+  }
+
+  *run = 0;
+  for(uint8_t shift = 0; ; shift += 3) {
+    uint8_t group = 0;
+    if(!rle_get(r, &group, 4)) return 0;
+    *run |= (uint32_t)(group & 0x7) << shift;
+    if(!(group & 0x8)) return 1;
+  }
+}
+
+#endif
@@ -1,13 +1,26 @@
 #ifndef _SAMPLER_H_
 #define _SAMPLER_H_
 
+// The host tools (see host/) build the decoder without the Arduino core
+#ifdef ARDUINO
 #include "Arduino.h"
+#else
+#include <stdint.h>
+#endif
+
+// Hysteresis for the analog input
+#include "slicer.h"
+// Filters for several readings per sample
+#include "oversample.h"
 
 // --------- Hardware configuration --------- 
 
+#ifdef ARDUINO
 static const int rxPin = 7;          // Receive pin for digital sampling (much faster than analog but requires level shifters)
 static const int rxPinAna = A0;      // Receive pin for analog reception
 static const int txPin = 3;          // Transmit pin, digital 5V output
+static const int rxPinCapture = 8;   // Receive pin for edge timing, fixed to the Timer1 input capture pin (ICP1)
+#endif
 
 // --------- Sampling settings --------- 
 
@@ -16,44 +29,88 @@ static const int txPin = 3;          // Transmit pin, digital 5V output
 //#define RX_ANALOG_LEVEL_LOW 230      // Analog level to drop below before detecting a '0'
 #define RX_ANALOG_LEVEL_HIGH 90     // Analog level to reach before a '1' is detected
 #define RX_ANALOG_LEVEL_LOW 70      // Analog level to drop below before detecting a '0'
+#define RX_ANALOG_ADAPTIVE 1         // When set to 1, move the thresholds with the signal (see slicer.h), the levels above are only the start
+#define RX_ANALOG_FREERUN 0          // When set to 1, let the ADC convert continuously and slice in its interrupt (analog only)
+#define RX_OVERSAMPLE 0              // When set to 1, filter about 4 fast 8 bit conversions per sample instead of slicing one (analog only, see oversample.h)
+#define RX_OVERSAMPLE_FILTER OVERSAMPLE_VOTE  // OVERSAMPLE_VOTE rejects spikes, OVERSAMPLE_SUM averages wide band noise (compare with host/adcbench)
 #define RX_INVERT 0                  // When level shifting causes an inversion - the sampler can simply be inverted
+#define RX_CAPTURE 0                 // When set to 1, time the edges on rxPinCapture with Timer1 instead of sampling (digital only)
+#define RX_TIMER_SAMPLER 0           // When set to 1, sample from a Timer2 interrupt instead of timing the main loop with micros()
+#define RX_MULTI 0                   // When set to 1, decode up to 8 digital receivers on one port with a single read (full decoder, see decodePort())
+#define RX_MULTI_PORT PINC           // Input register of the receiver port: PINC holds A0..A5 (all 8 pins of PIND include the serial port)
+#define RX_MULTI_DDR DDRC            // Direction register of the same port
+#define RX_MULTI_MASK 0x3F           // Receivers connected to the port, receiver i on bit i
+
+#if RX_CAPTURE && RX_TIMER_SAMPLER
+#error "Select either edge capture or the timer sampler"
+#endif
+
+#if RX_MULTI && (RX_ANALOG || RX_CAPTURE || RX_TIMER_SAMPLER)
+#error "The receiver port is read digitally in the sample loop"
+#endif
+
+#if RX_TIMER_SAMPLER && RX_ANALOG && !RX_ANALOG_FREERUN && !RX_OVERSAMPLE
+#error "The timer sampler reads the input in its interrupt: analog sampling needs the free-running ADC (RX_ANALOG_FREERUN or RX_OVERSAMPLE), analogRead() blocks"
+#endif
+
+#if RX_OVERSAMPLE && (!RX_ANALOG || RX_ANALOG_FREERUN)
+#error "Oversampling runs the ADC itself and needs analog sampling without RX_ANALOG_FREERUN"
+#endif
 
 // Sample interval in us; this should be sufficiently high to get an accurate bit stream
 // Note: the standard ADC settings require 220us per sample - which is useless; the ADC core clock is sped up to reduce this to 32us per sample at the cost of reduced resolution...
+// The host tools override this to sweep the interval, the pulse windows in protocol.h follow automatically
+#ifndef RX_SAMPLE_INTERVAL_US
 #define RX_SAMPLE_INTERVAL_US 50
+#endif
 
-// Utility function to handle reading from the analog or digital pins
-// Note that analog reading is needed when the receiver is running at 3.3V
-static inline uint8_t readRxPin() {
-#if RX_ANALOG
-  static uint8_t last = 0;
-  uint8_t val = 0;
-
-  // Do a read from the ADC
-  int anaval = analogRead(rxPinAna);
-
-  // Convert into a binary choice - to de-noise, use a gray area before flipping bits
-  if(last == 0) {
-    // Last sample was a 0; use the upper limit to switch to 1
-    val = anaval > RX_ANALOG_LEVEL_HIGH;
-  } else {
-    // Last sample was a 1; use the lower limit to switch to 1
-    val = anaval > RX_ANALOG_LEVEL_LOW;
-  }
-  
-  #if RX_INVERT
-  return !val;
-  #else
-  return val;
-  #endif
+#ifdef ARDUINO
+// Slice an ADC reading with the configured thresholds
+#if RX_ANALOG_ADAPTIVE
+#define RX_SLICE(s, val) slicer_adapt(s, val)
 #else
-  // Digital read
-  #if RX_INVERT
-  return !digitalRead(rxPin);
-  #else
-  return digitalRead(rxPin);
-  #endif
+#define RX_SLICE(s, val) slicer_step(s, val)
+#endif
+
+// Push a reading into the oversampling filter, and take a sample from the state the interrupt leaves
+#if RX_OVERSAMPLE_FILTER == OVERSAMPLE_SUM
+#define RX_OVERSAMPLE_PUSH(o, reading) oversample_sum_push(o, reading)
+#define RX_OVERSAMPLE_STATE(o) ((o)->sum)
+#define RX_OVERSAMPLE_SAMPLE(o, state) oversample_sum_sample(o, state, RX_ANALOG_ADAPTIVE)
+#else
+#define RX_OVERSAMPLE_PUSH(o, reading) oversample_vote_push(o, reading)
+#define RX_OVERSAMPLE_STATE(o) ((o)->votes)
+#define RX_OVERSAMPLE_SAMPLE(o, state) oversample_vote_sample(o, state, RX_ANALOG_ADAPTIVE)
+#endif
+
+#if RX_ANALOG && (RX_ANALOG_FREERUN || RX_OVERSAMPLE)
+// Latest sample of the free-running ADC
+#include "adc.h"
+#endif
+
+/**
+ * Raw analog reading of the receiver (10 bits), for recording ADC traces
+ */
+static inline uint16_t readRxAdc() {
+#if RX_ANALOG && (RX_ANALOG_FREERUN || RX_OVERSAMPLE)
+  return adc_reading();
+#else
+  return analogRead(rxPinAna);
 #endif
 }
 
+#if RX_MULTI
+/**
+ * All receivers with one read of their port, receiver i in bit i; the bits without a receiver read 0
+ */
+static inline uint8_t readRxPort() {
+#if RX_INVERT
+  return ~RX_MULTI_PORT & RX_MULTI_MASK;
+#else
+  return RX_MULTI_PORT & RX_MULTI_MASK;
+#endif
+}
+#endif
+#endif
+
 #endif
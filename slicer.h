@@ -0,0 +1,97 @@
+/**
+ * Analog slicer - turns ADC readings into receiver samples
+ *
+ * A reading above the upper threshold switches the output to 1, a reading below the lower threshold switches it
+ * back to 0; anything in between keeps the previous level so noise around a single threshold does not toggle the
+ * output. This is plain logic without register access so the host tools can run it on recorded ADC traces.
+ *
+ * The right thresholds depend on the receiver supply and the surroundings, so the adaptive slicer tracks the peak
+ * and the noise floor of the readings and keeps the hysteresis band centered between them. Both estimators follow
+ * the readings quickly in their own direction (attack) and slowly back (release): a single pulse is enough to move
+ * them, while the gap between two repeats of a frame is not long enough to forget the signal level.
+ */
+
+#ifndef _SLICER_H_
+#define _SLICER_H_
+
+#include <stdint.h>
+
+// The estimators are kept in 1/32 ADC steps so slow updates do not round away (10 bit readings still fit 16 bits)
+#define SLICER_SCALE 5
+
+// Estimator speeds as shifts: the attack moves 1/8 of the way per reading, the release 1/1024
+#define SLICER_ATTACK 3
+#define SLICER_RELEASE 10
+
+// Hysteresis is 1/4 of the span between noise floor and peak, but never less than twice this (in ADC steps) so a quiet
+// channel does not turn into a toggling output
+#define SLICER_MIN_BAND 8
+
+typedef struct {
+  uint16_t high;      // Level to reach before a '1' is detected
+  uint16_t low;       // Level to drop below before detecting a '0'
+  uint8_t level;      // Current output
+  uint16_t peak;      // Adaptive: estimated signal level, scaled by SLICER_SCALE
+  uint16_t noise;     // Adaptive: estimated noise floor, scaled by SLICER_SCALE
+} slicer_t;
+
+/**
+ * Start at level 0 with the given thresholds (10 bit ADC scale)
+ */
+static inline void slicer_init(slicer_t *s, uint16_t high, uint16_t low) {
+  s->high = high;
+  s->low = low;
+  s->level = 0;
+  // The adaptive slicer starts from the fixed thresholds
+  s->peak = high << SLICER_SCALE;
+  s->noise = low << SLICER_SCALE;
+}
+
+/**
+ * Slice one ADC reading
+ * @return the new output level
+ */
+static inline uint8_t slicer_step(slicer_t *s, uint16_t val) {
+  // A 1 holds until the reading drops to the lower threshold, a 0 until it passes the upper one
+  s->level = val > (s->level ? s->low : s->high);
+  return s->level;
+}
+
+/**
+ * Update the peak and floor estimates with one ADC reading and move the thresholds between them
+ */
+static inline void slicer_track(slicer_t *s, uint16_t val) {
+  uint16_t v = val << SLICER_SCALE;
+
+  if(v > s->peak) {
+    s->peak += (v - s->peak) >> SLICER_ATTACK;
+  } else {
+    s->peak -= (s->peak - v) >> SLICER_RELEASE;
+  }
+  if(v < s->noise) {
+    s->noise -= (s->noise - v) >> SLICER_ATTACK;
+  } else {
+    s->noise += (v - s->noise) >> SLICER_RELEASE;
+  }
+
+  uint16_t peak = s->peak >> SLICER_SCALE;
+  uint16_t noise = s->noise >> SLICER_SCALE;
+  uint16_t span = peak > noise ? peak - noise : 0;
+  uint16_t mid = noise + (span >> 1);
+  uint16_t band = span >> 3;
+  if(band < SLICER_MIN_BAND) band = SLICER_MIN_BAND;
+
+  s->high = mid + band;
+  s->low = mid > band ? mid - band : 0;
+}
+
+/**
+ * Move the thresholds with one ADC reading and slice it
+ * @return the new output level
+ */
+static inline uint8_t slicer_adapt(slicer_t *s, uint16_t val) {
+  slicer_track(s, val);
+  return slicer_step(s, val);
+}
+
+#endif
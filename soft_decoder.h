@@ -0,0 +1,218 @@
+/**
+ * Soft frame decoder - votes over the repeats of a burst to recover packets no single repeat delivers intact
+ *
+ * The frame decoder drops a whole frame at its first bad symbol. This decoder listens to the same events but only
+ * erases that symbol. All symbols of a frame have the same length, so the ones after a bad symbol are found again by
+ * time: a window of 4 events slides over the events until it holds a valid symbol which ends on a symbol boundary,
+ * and every boundary passed without one leaves an erased symbol. Each good symbol re-anchors the boundaries and
+ * refines the symbol length, so a transmitter with a skewed clock stays in step.
+ *
+ * At the PAUSE the frame votes with its good symbols: every bit has a score, +1 for each repeat which saw a 1 and -1
+ * for a 0. A packet comes out once two or more repeats voted, every bit has a majority and no repeat of the burst
+ * was decoded cleanly (the frame decoder reported that one already). A frame which disagrees with the majority in
+ * more than SOFT_MAX_CONFLICTS bits comes from another transmitter and starts a new vote.
+ *
+ * This is plain logic on the event stream; the caller supplies the time in samples.
+ */
+
+#ifndef _SOFT_DECODER_H_
+#define _SOFT_DECODER_H_
+
+#include <stdint.h>
+
+// Event codes and the sample conversions
+#include "decoder.h"
+// Protocol descriptors
+#include "protocols.h"
+
+// Bits a frame may disagree with the vote so far and still be a repeat of the same packet
+#define SOFT_MAX_CONFLICTS 3
+// Silence after which the next frame starts a new burst, in us: a bit more than a frame and the pause after it
+#define SOFT_BURST_GAP_US 150000UL
+
+template<typename P>
+struct soft_decoder {
+  typedef typename P::word_t word_t;
+
+  // Nominal symbol length and burst gap in samples
+  static constexpr uint16_t nominal = US_TO_SAMPLES(2 * P::high_us + P::short_us + P::long_us);
+  static constexpr uint32_t gap = US_TO_SAMPLES(SOFT_BURST_GAP_US);
+
+  word_t word;                 // Symbols of the current frame, erased ones are 0
+  word_t known;                // Good symbols of the current frame
+  word_t result;               // Voted packet, valid when push() returns 1
+  uint32_t next;               // Expected end of the current symbol
+  uint32_t prev;               // End of the previous symbol when it was good (or of the SYNC)
+  uint32_t last;               // Time of the last frame which voted
+  uint16_t period;             // Symbol length of the current frame
+  uint8_t eventbuf[4];         // Event window
+  uint8_t ep;                  // Events in the window
+  uint8_t n;                   // Current symbol
+  uint8_t active;              // Set between a SYNC and the PAUSE
+  uint8_t linked;              // Set when the previous symbol was good, so prev is one period back
+  int8_t score[P::bits];       // Votes per bit, bit 0 first: positive for a 1, negative for a 0
+  uint8_t frames;              // Frames which voted in this burst
+  uint8_t done;                // Set once the packet of this burst came out (cleanly or by vote)
+
+  /**
+   * Reset the decoder state and the vote
+   */
+  void init() {
+    // The frame fields are only read after a SYNC sets them
+    word = 0;
+    known = 0;
+    next = 0;
+    prev = 0;
+    period = nominal;
+    ep = 0;
+    n = 0;
+    linked = 0;
+    active = 0;
+    last = 0;
+    reset();
+  }
+
+  /**
+   * Start a new vote
+   */
+  void reset() {
+    for(uint8_t i = 0; i < P::bits; i++) score[i] = 0;
+    frames = 0;
+    done = 0;
+  }
+
+  /**
+   * Process one event from the pulse detector, along with the frame decoder
+   * @param now time of the event in samples
+   * @param clean result of the frame decoder for the same event
+   * @return 1 when a packet was voted, see result
+   */
+  uint8_t push(uint8_t event, uint32_t now, uint8_t clean) {
+    switch(event) {
+      case EVENT_SYNC:
+        // Start of a frame, the symbols follow right after it
+        word = 0;
+        known = 0;
+        n = 0;
+        ep = 0;
+        period = nominal;
+        next = now + period;
+        prev = now;
+        linked = 1;
+        active = 1;
+        return 0;
+      case EVENT_HIGH_SHORT:
+      case EVENT_LOW_SHORT:
+      case EVENT_LOW_LONG:
+      case EVENT_INVALID:
+        if(active) symbol(event, now);
+        return 0;
+      case EVENT_PAUSE:
+        if(!active) return 0;
+        active = 0;
+        // The symbols missing at the end are erased as well
+        while(n < P::bits) skip();
+        return vote(now, clean);
+    }
+    return 0;
+  }
+
+  /**
+   * Leave the current symbol erased and move to the next one
+   */
+  void skip() {
+    word <<= 1;
+    known <<= 1;
+    next += period;
+    linked = 0;
+    n++;
+  }
+
+  /**
+   * Add an event to the window and take the symbol in it when it is valid and ends on the boundary
+   */
+  void symbol(uint8_t event, uint32_t now) {
+    // Boundaries passed without a good symbol
+    while(n < P::bits && (int32_t)(now - next) > (int32_t)(period >> 1)) skip();
+
+    if(ep == 4) {
+      eventbuf[0] = eventbuf[1];
+      eventbuf[1] = eventbuf[2];
+      eventbuf[2] = eventbuf[3];
+      ep = 3;
+    }
+    eventbuf[ep++] = event;
+    if(ep < 4 || n >= P::bits) return;
+
+    // Half a symbol out also makes a valid window, the boundary tells them apart. The first symbol is measured
+    // against the nominal length and may be further off.
+    int32_t off = now - next;
+    int16_t tol = n ? period >> 3 : period >> 2;
+    if(off > tol || off < -tol) return;
+
+    if(eventbuf[0] != EVENT_HIGH_SHORT || (eventbuf[1] != EVENT_LOW_SHORT && eventbuf[1] != EVENT_LOW_LONG) ||
+       eventbuf[2] != EVENT_HIGH_SHORT || (eventbuf[3] != EVENT_LOW_SHORT && eventbuf[3] != EVENT_LOW_LONG)) {
+      return;
+    }
+    uint8_t value = P::symbol(((eventbuf[1] == EVENT_LOW_LONG) << 1) | (eventbuf[3] == EVENT_LOW_LONG), n);
+    if(value == SYMBOL_INVALID) return;
+
+    // Good symbol: it ends the slot, the next boundary is counted from here
+    if(linked) period = (3 * period + (uint16_t)(now - prev)) >> 2;
+    word = (word << 1) | value;
+    known = (known << 1) | 1;
+    next = now + period;
+    prev = now;
+    linked = 1;
+    ep = 0;
+    n++;
+  }
+
+  /**
+   * Add the frame which just ended to the vote
+   * @return 1 when the vote delivered a packet
+   */
+  uint8_t vote(uint32_t now, uint8_t clean) {
+    if(now - last > gap) reset();
+    last = now;
+
+    // Good symbols and disagreements with the vote so far
+    uint8_t good = 0, conflicts = 0;
+    word_t mask = 1;
+    for(uint8_t i = 0; i < P::bits; i++, mask <<= 1) {
+      if(!(known & mask)) continue;
+      good++;
+      if(score[i] && (score[i] > 0) != ((word & mask) != 0)) conflicts++;
+    }
+
+    // Frames with too little left are most likely noise
+    if(good >= P::bits / 2) {
+      if(conflicts > SOFT_MAX_CONFLICTS) reset();
+      mask = 1;
+      for(uint8_t i = 0; i < P::bits; i++, mask <<= 1) {
+        if(!(known & mask)) continue;
+        if(word & mask) {
+          if(score[i] < 127) score[i]++;
+        } else {
+          if(score[i] > -127) score[i]--;
+        }
+      }
+      if(frames < 0xFF) frames++;
+    }
+
+    if(clean) done = 1;
+    if(done || frames < 2) return 0;
+
+    // Every bit needs a majority
+    result = 0;
+    mask = 1;
+    for(uint8_t i = 0; i < P::bits; i++, mask <<= 1) {
+      if(!score[i]) return 0;
+      if(score[i] > 0) result |= mask;
+    }
+    done = 1;
+    return 1;
+  }
+};
+
+#endif
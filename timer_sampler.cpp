@@ -0,0 +1,93 @@
+
+#include "timer_sampler.h"
+// Ring between the interrupt and the main loop
+#include "ring.h"
+// Load the project config
+#include "config.h"
+// The receiver input as a sample source
+#include "receiver.h"
+
+// Only implement the functions when the timer sampler is enabled
+#if RX_TIMER_SAMPLER && defined(ARDUINO)
+
+// Pick the smallest Timer2 prescaler for which the sample interval fits the 8 bit compare register
+#define TIMER_TICKS_8   (RX_SAMPLE_INTERVAL_US * (F_CPU / 8000000UL))
+#define TIMER_TICKS_32  (RX_SAMPLE_INTERVAL_US * (F_CPU / 1000000UL) / 32)
+#define TIMER_TICKS_128 (RX_SAMPLE_INTERVAL_US * (F_CPU / 1000000UL) / 128)
+
+#if TIMER_TICKS_8 <= 256
+#define TIMER_TICKS TIMER_TICKS_8
+#define TIMER_PRESCALER _BV(CS21)
+#elif TIMER_TICKS_32 <= 256
+#define TIMER_TICKS TIMER_TICKS_32
+#define TIMER_PRESCALER (_BV(CS21) | _BV(CS20))
+#elif TIMER_TICKS_128 <= 256
+#define TIMER_TICKS TIMER_TICKS_128
+#define TIMER_PRESCALER (_BV(CS22) | _BV(CS20))
+#else
+#error "Sample interval too long for Timer2"
+#endif
+
+static ring_t ring;
+static volatile uint16_t overruns = 0;
+static rx_source_t source;
+
+/**
+ * Sample tick: read the receiver and pack the sample, push every complete byte into the ring
+ */
+ISR(TIMER2_COMPA_vect) {
+  static uint8_t curbyte = 0;
+  static uint8_t bitcnt = 0;
+
+  curbyte = (curbyte << 1) | source.read();
+  if(++bitcnt < 8) return;
+
+  bitcnt = 0;
+  if(!ring_push(&ring, curbyte)) {
+    // The main loop fell behind by a whole ring - these samples are lost
+    overruns++;
+  }
+}
+
+/**
+ * Configure Timer2 and start sampling
+ */
+void sampler_start() {
+  ring_init(&ring);
+  source.begin();
+
+  noInterrupts();
+  TCCR2A = _BV(WGM21);        // CTC mode: count to OCR2A and restart
+  TCCR2B = TIMER_PRESCALER;
+  OCR2A = TIMER_TICKS - 1;
+  TCNT2 = 0;
+  TIMSK2 = _BV(OCIE2A);       // Interrupt on every compare match
+  interrupts();
+}
+
+/**
+ * Take the oldest 8 samples from the ring
+ */
+uint8_t sampler_read(uint8_t *samples) {
+  return ring_pop(&ring, samples);
+}
+
+/**
+ * Number of sample bytes waiting in the ring
+ */
+uint8_t sampler_pending() {
+  return ring_count(&ring);
+}
+
+/**
+ * Number of sample bytes lost because the ring was full
+ */
+uint16_t sampler_overruns() {
+  uint16_t res;
+  noInterrupts();
+  res = overruns;
+  interrupts();
+  return res;
+}
+
+#endif
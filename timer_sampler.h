@@ -0,0 +1,38 @@
+/**
+ * Timer sampler - samples the receiver from a Timer2 interrupt on a fixed grid
+ *
+ * The interrupt reads the receiver input (rx_source_t, receiver.h) every RX_SAMPLE_INTERVAL_US, packs the samples
+ * 8 per byte (first sample in the most significant bit) and pushes the bytes into a ring. The main loop decodes
+ * from the ring whenever it has time, so slow output no longer moves the sampling points; it only has to catch up
+ * before the ring is full.
+ * The input has to be read without waiting: digital, or analog from the free-running ADC, whose own interrupt
+ * converts while the timer waits (sampler.h refuses a blocking analogRead() here).
+ */
+
+#ifndef _TIMER_SAMPLER_H_
+#define _TIMER_SAMPLER_H_
+
+#include <stdint.h>
+
+/**
+ * Configure Timer2 and start sampling
+ */
+void sampler_start();
+
+/**
+ * Take the oldest 8 samples from the ring
+ * @return 0 when no complete byte of samples is waiting
+ */
+uint8_t sampler_read(uint8_t *samples);
+
+/**
+ * Number of sample bytes waiting in the ring
+ */
+uint8_t sampler_pending();
+
+/**
+ * Number of sample bytes lost because the ring was full
+ */
+uint16_t sampler_overruns();
+
+#endif
@@ -0,0 +1,81 @@
+#include "timing.h"
+// Load the project config
+#include "config.h"
+
+// Only implement the functions when the instrumentation is enabled
+#if SAMPLE_LOOP_TIMING && defined(ARDUINO)
+
+// Calls to timing_due() between checks of the serial port
+#define TIMING_CHECK_EVERY 256
+
+// Checks between the periodic reports
+#define TIMING_REPORT_CHECKS ((uint32_t)TIMING_REPORT_S * 1000000UL / RX_SAMPLE_INTERVAL_US / TIMING_CHECK_EVERY)
+
+static const char *stage_names[TIMING_STAGES] = { "read", "detect", "frame", "debounce", "output" };
+
+/**
+ * Configure Timer1 as the clock, keeping the input capture settings of the edge capture
+ */
+void timing_start() {
+  noInterrupts();
+  TCCR1A = 0;                                                   // Normal mode, free running 16 bit counter
+  TCCR1B = (TCCR1B & (_BV(ICNC1) | _BV(ICES1))) | _BV(CS11);    // Clock / 8
+  interrupts();
+}
+
+/**
+ * Call once per iteration: check if a report is due
+ */
+uint8_t timing_due() {
+  static uint8_t calls = 0;
+  static uint32_t checks = 0;
+
+  if(++calls != 0) return 0;
+
+  // Any character requests a report, '?' is the documented one
+  if(Serial.available() > 0) {
+    while(Serial.available() > 0) Serial.read();
+    checks = 0;
+    return 1;
+  }
+
+#if TIMING_REPORT_S
+  if(++checks >= TIMING_REPORT_CHECKS) {
+    checks = 0;
+    return 1;
+  }
+#endif
+  return 0;
+}
+
+/**
+ * Print the counters in one line and clear them
+ */
+void timing_report(timing_t *t) {
+  Serial.print("Timing: n=");
+  Serial.print(t->iterations);
+  Serial.print(" max=");
+  Serial.print(t->max_us);
+  Serial.print("us over=");
+  Serial.print(t->overruns);
+  Serial.print(" hist=");
+  for(uint8_t b = 0; b < TIMING_BUCKETS; b++) {
+    if(b) Serial.print('/');
+    Serial.print(t->hist[b]);
+  }
+
+  // Average and longest time per stage, in us
+  for(uint8_t s = 0; s < TIMING_STAGES; s++) {
+    Serial.print(' ');
+    Serial.print(stage_names[s]);
+    Serial.print('=');
+    Serial.print(t->iterations ? (float)t->stage_ticks[s] / t->iterations / TIMING_TICKS_PER_US : 0.0f, 1);
+    Serial.print('/');
+    Serial.print(t->stage_max[s] / TIMING_TICKS_PER_US);
+  }
+  Serial.println("us");
+
+  timing_init(t);
+}
+
+#endif
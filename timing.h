@@ -0,0 +1,115 @@
+/**
+ * Sample loop timing - where the sample interval goes, without printing from the sample loop
+ *
+ * Every iteration of the sample loop is recorded into a few counters: the longest iteration, the number of
+ * iterations longer than the sample interval and a histogram of the iteration time in power of 2 buckets of us.
+ * The stages of an iteration (reading the receiver, pulse detection, frame assembly, debouncing and the packet
+ * output) are timed separately. Recording costs a few additions per iteration; the counters are printed on request
+ * (send '?' on the serial console) or every TIMING_REPORT_S seconds, and start over after each report.
+ *
+ * The clock is Timer1 running free at F_CPU / 8 (0.5 us per tick at 16 MHz), the same setup the edge capture and
+ * the transmitter use. micros() only has a resolution of 4 us, too coarse for the stages.
+ */
+
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#else
+#include <stdint.h>
+#endif
+
+// Stages of a sample loop iteration
+#define TIMING_READ     0    // Reading the receiver input
+#define TIMING_DETECT   1    // detectPulse()
+#define TIMING_FRAME    2    // Frame assembly
+#define TIMING_DEBOUNCE 3    // Debouncer
+#define TIMING_OUTPUT   4    // Packet output in the slack time
+#define TIMING_STAGES   5
+
+// Histogram buckets: bucket b counts iterations of 2^(b-1) up to 2^b - 1 us (bucket 0: below 1 us), the last one
+// everything from 128 us
+#define TIMING_BUCKETS 9
+
+// Seconds between reports, 0 to only report on request
+#define TIMING_REPORT_S 60
+
+typedef struct {
+  uint32_t iterations;                  // Iterations recorded
+  uint16_t overruns;                    // Iterations longer than the sample interval
+  uint16_t max_us;                      // Longest iteration
+  uint16_t hist[TIMING_BUCKETS];        // Iterations per time bucket, saturating
+  uint32_t stage_ticks[TIMING_STAGES];  // Total time per stage, in timer ticks
+  uint16_t stage_max[TIMING_STAGES];    // Longest time per stage, in timer ticks
+} timing_t;
+
+/**
+ * Clear the counters
+ */
+static inline void timing_init(timing_t *t) {
+  uint8_t *p = (uint8_t *)t;
+  for(uint16_t i = 0; i < sizeof(timing_t); i++) p[i] = 0;
+}
+
+/**
+ * Add the time of one stage, in timer ticks
+ */
+static inline void timing_stage(timing_t *t, uint8_t stage, uint16_t ticks) {
+  t->stage_ticks[stage] += ticks;
+  if(ticks > t->stage_max[stage]) t->stage_max[stage] = ticks;
+}
+
+/**
+ * Histogram bucket of an iteration time: the number of significant bits
+ */
+static inline uint8_t timing_bucket(uint16_t us) {
+  uint8_t b = 0;
+  while(us && b < TIMING_BUCKETS - 1) {
+    us >>= 1;
+    b++;
+  }
+  return b;
+}
+
+/**
+ * Record one iteration of the sample loop
+ */
+static inline void timing_iteration(timing_t *t, uint16_t us, uint16_t interval_us) {
+  uint8_t b = timing_bucket(us);
+
+  t->iterations++;
+  if(us > interval_us && t->overruns < 0xFFFF) t->overruns++;
+  if(us > t->max_us) t->max_us = us;
+  if(t->hist[b] < 0xFFFF) t->hist[b]++;
+}
+
+#ifdef ARDUINO
+// Timer1 runs at F_CPU / 8: 0.5 us per tick at 16 MHz
+#define TIMING_TICKS_PER_US (F_CPU / 8000000UL)
+
+/**
+ * Current time in timer ticks
+ */
+static inline uint16_t timing_now() {
+  return TCNT1;
+}
+
+/**
+ * Configure Timer1 as the clock, keeping the input capture settings of the edge capture
+ */
+void timing_start();
+
+/**
+ * Call once per iteration: check if a report is due, requested on the serial console or TIMING_REPORT_S passed.
+ * Only every 256th call looks at the serial port.
+ */
+uint8_t timing_due();
+
+/**
+ * Print the counters in one line and clear them
+ */
+void timing_report(timing_t *t);
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * Event trace - the binary output of the debug decoder (DEBUG_TRACE in decoder_debug.h)
+ *
+ * Every pulse of the receiver becomes one record: its level, its length in samples and the event the pulse detector
+ * reported for it (the first one when it reported several, EVENT_NONE for a glitch it ignored). The lengths of all
+ * pulses add up to the samples taken, so the host rebuilds the sample stream and the time of every event.
+ * The first byte of a record has the top bit set and the bytes after it have it clear: a reader which starts in
+ * the middle of the stream or loses bytes picks up at the next record, and text in between is told apart.
+ *
+ *   pulse:   1 L EEEE NN  <NN bytes: length, 7 bits each, least significant first>  (NN = 1..3)
+ *   time:    0xFE         <4 bytes: samples taken before the next record, 28 bits>
+ *   dropped: 0xFF         <3 bytes: samples whose records were lost, 21 bits>
+ *
+ * L is the level of the pulse and EEEE its event code; event code 15 is never used, so 0xFE and 0xFF are free.
+ * A pulse too long for one record continues in the next one with the same level.
+ * This is plain logic, shared by the sketch and the host viewer (host/tracedump.cpp).
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+// Event codes
+#include "decoder.h"
+
+#define TRACE_TIME    0xFE
+#define TRACE_DROPPED 0xFF
+
+// Longest pulse and number of lost samples in one record
+#define TRACE_MAX_RUN ((1UL << 21) - 1)
+
+// Largest record in bytes
+#define TRACE_RECORD_MAX 5
+
+static_assert(EVENT_PAUSE < 15, "Event codes must fit in 4 bits, 15 marks the other records");
+
+// Pulse being traced
+typedef struct {
+  uint32_t run;          // Samples of the pulse so far
+  uint8_t level;         // Level of the pulse
+  uint8_t event;         // First event reported for the pulse
+  uint32_t ended;        // Length of the pulse of the last record returned by trace_sample()
+} trace_pulse_t;
+
+/**
+ * Store a value in 7 bit groups, least significant first
+ */
+static inline uint8_t trace_put7(uint8_t *buf, uint32_t val, uint8_t n) {
+  for(uint8_t i = 0; i < n; i++) buf[i] = (val >> (7 * i)) & 0x7F;
+  return n;
+}
+
+/**
+ * Read a value stored in 7 bit groups
+ */
+static inline uint32_t trace_get7(const uint8_t *buf, uint8_t n) {
+  uint32_t val = 0;
+  for(uint8_t i = 0; i < n; i++) val |= (uint32_t)buf[i] << (7 * i);
+  return val;
+}
+
+/**
+ * Size of a record by its first byte, 0 when it is not the first byte of a record
+ */
+static inline uint8_t trace_record_size(uint8_t b) {
+  if(!(b & 0x80)) return 0;
+  if(b == TRACE_TIME) return 5;
+  if(b == TRACE_DROPPED) return 4;
+  return 1 + MAX(1, b & 0x3);
+}
+
+/**
+ * Pulse record, the length at most TRACE_MAX_RUN
+ * @return size of the record
+ */
+static inline uint8_t trace_put_pulse(uint8_t *buf, uint8_t level, uint8_t event, uint32_t run) {
+  uint8_t n = run < (1UL << 7) ? 1 : run < (1UL << 14) ? 2 : 3;
+  buf[0] = 0x80 | (level << 6) | (event << 2) | n;
+  return 1 + trace_put7(buf + 1, run, n);
+}
+
+/**
+ * Time record: samples taken before the next record (wraps at 28 bits)
+ */
+static inline uint8_t trace_put_time(uint8_t *buf, uint32_t samples) {
+  buf[0] = TRACE_TIME;
+  return 1 + trace_put7(buf + 1, samples, 4);
+}
+
+/**
+ * Dropped record: samples whose records were lost, at most TRACE_MAX_RUN
+ */
+static inline uint8_t trace_put_dropped(uint8_t *buf, uint32_t samples) {
+  buf[0] = TRACE_DROPPED;
+  return 1 + trace_put7(buf + 1, samples, 3);
+}
+
+/**
+ * Start tracing at a low level, which is what the pulse detector starts from
+ */
+static inline void trace_init(trace_pulse_t *p) {
+  p->run = 0;
+  p->level = 0;
+  p->event = EVENT_NONE;
+  p->ended = 0;
+}
+
+/**
+ * Follow one sample along with the event the pulse detector reported for it. The pulse detector reports a pulse at
+ * the edge which ends it, so the event at an edge still belongs to the pulse before it.
+ * @return size of the record in buf when a pulse ended (or is too long for one record), otherwise 0
+ */
+static inline uint8_t trace_sample(trace_pulse_t *p, uint8_t val, uint8_t event, uint8_t *buf) {
+  uint8_t size = 0;
+
+  if(p->event == EVENT_NONE) p->event = event;
+  if(val != p->level) {
+    // Only the very first sample can end an empty pulse
+    if(p->run) size = trace_put_pulse(buf, p->level, p->event, p->run);
+    p->ended = p->run;
+    p->run = 0;
+    p->level = val;
+    p->event = EVENT_NONE;
+  }
+
+  if(++p->run == TRACE_MAX_RUN) {
+    // The next record of the same level continues the pulse
+    size = trace_put_pulse(buf, p->level, p->event, p->run);
+    p->ended = p->run;
+    p->run = 0;
+  }
+  return size;
+}
+
+/**
+ * End the record of the pulse so far, before a gap in the samples; the rest of the pulse continues in the next
+ * record with the same level
+ * @return size of the record in buf, 0 when the pulse has no samples yet
+ */
+static inline uint8_t trace_flush(trace_pulse_t *p, uint8_t *buf) {
+  if(!p->run) return 0;
+
+  uint8_t size = trace_put_pulse(buf, p->level, p->event, p->run);
+  p->ended = p->run;
+  p->run = 0;
+  p->event = EVENT_NONE;
+  return size;
+}
+
+#endif
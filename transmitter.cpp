@@ -0,0 +1,89 @@
+#include "transmitter.h"
+// Load the project config
+#include "config.h"
+
+// Only implement the functions when the transmitter is enabled
+#if ENABLE_TRANSMITTER && defined(ARDUINO)
+
+// Timer1 runs at F_CPU / 8: 0.5 us per tick at 16 MHz
+#define TX_TICKS_PER_US (F_CPU / 8000000UL)
+
+// Delay from tx_send() to the first edge, in timer ticks
+#define TX_START_TICKS 32
+
+static_assert(TX_PAUSE_US * TX_TICKS_PER_US < 65536, "The pause does not fit the 16 bit compare register");
+
+// Packet being sent, only changed while the interrupt is disabled
+static tx_frame_t frame;
+static volatile uint8_t pos;            // Next pulse to start
+static volatile uint8_t repeats_left;   // Frames left to send, including the current one
+
+// Output register and mask of txPin, so the interrupt does not go through digitalWrite()
+static volatile uint8_t *tx_port;
+static uint8_t tx_mask;
+
+/**
+ * End of a pulse: start the next one and set the compare for its end
+ */
+ISR(TIMER1_COMPB_vect) {
+  if(pos == TX_PULSES) {
+    pos = 0;
+    if(--repeats_left == 0) {
+      // The pause of the last frame is over (txPin is low), stop until the next packet
+      TIMSK1 &= ~_BV(OCIE1B);
+      return;
+    }
+  }
+
+  if(TX_PULSE_LEVEL(pos)) {
+    *tx_port |= tx_mask;
+  } else {
+    *tx_port &= ~tx_mask;
+  }
+  // Relative to the previous compare, not to now: latency of this interrupt does not move the following edges
+  OCR1B += tx_pulse_us(&frame, pos) * TX_TICKS_PER_US;
+  pos++;
+}
+
+/**
+ * Configure txPin and Timer1, keeping the input capture settings of the edge capture
+ */
+void tx_start() {
+  pinMode(txPin, OUTPUT);
+  digitalWrite(txPin, LOW);
+  tx_port = portOutputRegister(digitalPinToPort(txPin));
+  tx_mask = digitalPinToBitMask(txPin);
+
+  noInterrupts();
+  TCCR1A = 0;                                                   // Normal mode, free running 16 bit counter
+  TCCR1B = (TCCR1B & (_BV(ICNC1) | _BV(ICES1))) | _BV(CS11);    // Clock / 8
+  TIMSK1 &= ~_BV(OCIE1B);
+  interrupts();
+}
+
+/**
+ * Start sending a packet, the interrupt sends it repeats times
+ */
+uint8_t tx_send(const nexa_pckt_t *p, uint8_t repeats) {
+  if(tx_busy() || repeats == 0) return 0;
+
+  tx_frame_build(&frame, *(const uint32_t *)p);
+  pos = 0;
+  repeats_left = repeats;
+
+  noInterrupts();
+  OCR1B = TCNT1 + TX_START_TICKS;
+  TIFR1 = _BV(OCF1B);         // Clear a stale match
+  TIMSK1 |= _BV(OCIE1B);
+  interrupts();
+  return 1;
+}
+
+/**
+ * Check if a packet is being sent
+ */
+uint8_t tx_busy() {
+  return (TIMSK1 & _BV(OCIE1B)) != 0;
+}
+
+#endif
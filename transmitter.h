@@ -0,0 +1,104 @@
+/**
+ * Transmitter - sends Nexa packets on txPin from a timer interrupt
+ *
+ * A packet is turned into a pulse table once: every pulse of the frame is one of four widths, stored as a 2 bit
+ * code (33 bytes per frame). The levels alternate, starting with a high pulse, so they are not stored at all.
+ * The compare B interrupt of the free running Timer1 plays the table the requested number of times, setting every
+ * edge at an absolute time so interrupt latency does not add up over the frame. The main loop keeps running.
+ *
+ * Timer1 runs in normal mode at F_CPU / 8, the same setup the edge capture uses (capture.h); the capture only uses
+ * the input capture unit and compare A, so both work at the same time. PWM on pins 9 and 10 is no longer available.
+ *
+ * Building the table is plain logic so the host tools can play it back into the decoder (see host/loopback.cpp).
+ */
+
+#ifndef _TRANSMITTER_H_
+#define _TRANSMITTER_H_
+
+#include <stdint.h>
+
+// Nominal pulse widths and the packet layout
+#include "protocol.h"
+
+// Silence after each frame, in us - longer than the END pulse of the decoder
+#define TX_PAUSE_US 10000
+
+// Number of frames per packet: Nexa remotes send 5, Proove/Anslut 6
+#define TX_REPEATS_NEXA 5
+#define TX_REPEATS_PROOVE 6
+
+// Pulse codes in the table
+#define TX_SHORT 0
+#define TX_LONG  1
+#define TX_START 2
+#define TX_PAUSE 3
+
+// SYNC (high + start), 4 pulses per bit, the final high and the pause
+#define TX_PULSES (2 + 32 * 4 + 2)
+#define TX_TABLE_SIZE (TX_PULSES / 4)
+
+// Level of pulse n: even pulses are high
+#define TX_PULSE_LEVEL(n) (!((n) & 0x1))
+
+typedef struct {
+  uint8_t codes[TX_TABLE_SIZE];   // 2 bits per pulse, the first pulse in the lowest bits
+} tx_frame_t;
+
+/**
+ * Store the code of pulse n
+ */
+static inline void tx_frame_put(tx_frame_t *f, uint8_t n, uint8_t code) {
+  uint8_t shift = (n & 0x3) << 1;
+  f->codes[n >> 2] = (f->codes[n >> 2] & ~(0x3 << shift)) | (code << shift);
+}
+
+/**
+ * Build the pulse table for a raw 32 bit packet (see nexa_pckt_t): 1 = hLhl, 0 = hlhL, MSB first
+ */
+static inline void tx_frame_build(tx_frame_t *f, uint32_t raw) {
+  uint8_t n = 0;
+
+  for(uint8_t i = 0; i < TX_TABLE_SIZE; i++) f->codes[i] = 0;
+
+  tx_frame_put(f, n++, TX_SHORT);
+  tx_frame_put(f, n++, TX_START);
+
+  for(int8_t i = 31; i >= 0; i--) {
+    uint8_t bit = (raw >> i) & 0x1;
+    tx_frame_put(f, n++, TX_SHORT);
+    tx_frame_put(f, n++, bit ? TX_LONG : TX_SHORT);
+    tx_frame_put(f, n++, TX_SHORT);
+    tx_frame_put(f, n++, bit ? TX_SHORT : TX_LONG);
+  }
+
+  tx_frame_put(f, n++, TX_SHORT);
+  tx_frame_put(f, n, TX_PAUSE);
+}
+
+/**
+ * Width of pulse n in us
+ */
+static inline uint16_t tx_pulse_us(const tx_frame_t *f, uint8_t n) {
+  static const uint16_t widths[4] = { SHORT_PULSE, LONG_PULSE, START_PULSE, TX_PAUSE_US };
+  return widths[(f->codes[n >> 2] >> ((n & 0x3) << 1)) & 0x3];
+}
+
+#ifdef ARDUINO
+/**
+ * Configure txPin and Timer1, keeping the input capture settings of the edge capture
+ */
+void tx_start();
+
+/**
+ * Start sending a packet, the interrupt sends it repeats times
+ * @return 0 when the previous packet is still being sent
+ */
+uint8_t tx_send(const nexa_pckt_t *p, uint8_t repeats);
+
+/**
+ * Check if a packet is being sent
+ */
+uint8_t tx_busy();
+#endif
+
+#endif